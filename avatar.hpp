@@ -2,6 +2,7 @@
 
 #include "player.hpp"
 #include "tool.hpp"
+#include "exposure_tracker.hpp"
 
 class Avatar : public Player
 {
@@ -33,5 +34,10 @@ public:
     const Mine& mine() const { return toolkit.mine; }
     Mine& mine() { return toolkit.mine; }
 
+    // What the opponent knows about our position.
+    Exposure_tracker exposure_tracker;
+    const Exposure_tracker& exposure() const { return exposure_tracker; }
+    Exposure_tracker& exposure() { return exposure_tracker; }
+
     bool has_lost_life() const;
 };
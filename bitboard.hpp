@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <algorithm>
+#include <cassert>
+
+// Set of cell indices of a padded grid (see padded_grid.hpp), one bit per cell.
+// The words are stored inline: copying a bitboard never allocates.
+class Bitboard
+{
+public:
+    using Word = uint64_t;
+    inline static constexpr int word_bits = 64;
+    inline static constexpr int max_size = 16 * word_bits;
+
+    explicit Bitboard(int size = 0) : size_(size), number_of_words_((size + word_bits - 1) / word_bits)
+    {
+        assert(size <= max_size);
+    }
+
+    inline int size() const { return size_; }
+    inline const Word* begin() const { return words_.data(); }
+    inline const Word* end() const { return words_.data() + number_of_words_; }
+
+    inline bool test(int index) const { return (words_[index / word_bits] >> (index % word_bits)) & 1; }
+    inline void set(int index) { words_[index / word_bits] |= Word(1) << (index % word_bits); }
+    inline void reset(int index) { words_[index / word_bits] &= ~(Word(1) << (index % word_bits)); }
+
+    void clear() { std::fill_n(words_.begin(), number_of_words_, 0); }
+
+    std::size_t count() const
+    {
+        std::size_t res = 0;
+        for (Word word : *this)
+            res += __builtin_popcountll(word);
+        return res;
+    }
+
+    bool any() const
+    {
+        return std::any_of(begin(), end(), [](Word word) { return word != 0; });
+    }
+    bool none() const { return !any(); }
+    // Lowest and highest cells of the set, -1 if it is empty.
+    int first() const
+    {
+        for (int i = 0; i < number_of_words_; ++i)
+            if (words_[i] != 0)
+                return i * word_bits + __builtin_ctzll(words_[i]);
+        return -1;
+    }
+    int last() const
+    {
+        for (int i = number_of_words_; i-- > 0;)
+            if (words_[i] != 0)
+                return i * word_bits + word_bits - 1 - __builtin_clzll(words_[i]);
+        return -1;
+    }
+    // True if the sets share a cell: (*this & other).any() without the copy.
+    bool intersects(const Bitboard& other) const
+    {
+        for (int i = 0; i < number_of_words_; ++i)
+            if (words_[i] & other.words_[i])
+                return true;
+        return false;
+    }
+
+    Bitboard& operator&=(const Bitboard& other)
+    {
+        for (int i = 0; i < number_of_words_; ++i)
+            words_[i] &= other.words_[i];
+        return *this;
+    }
+    Bitboard& operator|=(const Bitboard& other)
+    {
+        for (int i = 0; i < number_of_words_; ++i)
+            words_[i] |= other.words_[i];
+        return *this;
+    }
+    // Removes the cells of other.
+    Bitboard& subtract(const Bitboard& other)
+    {
+        for (int i = 0; i < number_of_words_; ++i)
+            words_[i] &= ~other.words_[i];
+        return *this;
+    }
+
+    // Moves every cell by offset (cell index i becomes i + offset). Cells moved outside [0,size()[ are lost.
+    Bitboard& shift(int offset)
+    {
+        const int number_of_words = number_of_words_;
+        const int word_shift = (offset < 0 ? -offset : offset) / word_bits;
+        const int bit_shift = (offset < 0 ? -offset : offset) % word_bits;
+        auto word = [&](int i) { return i >= 0 && i < number_of_words ? words_[i] : Word(0); };
+        if (offset >= 0)
+        {
+            for (int i = number_of_words - 1; i >= 0; --i)
+                words_[i] = (word(i - word_shift) << bit_shift)
+                        | (bit_shift ? word(i - word_shift - 1) >> (word_bits - bit_shift) : Word(0));
+        }
+        else
+        {
+            for (int i = 0; i < number_of_words; ++i)
+                words_[i] = (word(i + word_shift) >> bit_shift)
+                        | (bit_shift ? word(i + word_shift + 1) << (word_bits - bit_shift) : Word(0));
+        }
+        if (size_ % word_bits != 0 && number_of_words > 0)
+            words_[number_of_words - 1] &= (Word(1) << (size_ % word_bits)) - 1;
+        return *this;
+    }
+
+    friend Bitboard operator&(Bitboard lhs, const Bitboard& rhs) { return lhs &= rhs; }
+    friend Bitboard operator|(Bitboard lhs, const Bitboard& rhs) { return lhs |= rhs; }
+    friend bool operator==(const Bitboard& lhs, const Bitboard& rhs)
+    {
+        return lhs.size_ == rhs.size_ && std::equal(lhs.begin(), lhs.end(), rhs.begin());
+    }
+    friend bool operator!=(const Bitboard& lhs, const Bitboard& rhs) { return !(lhs == rhs); }
+
+    // Calls function(index) for each cell of the set, in increasing order.
+    template <class Function>
+    void for_each(Function&& function) const
+    {
+        for (int i = 0; i < number_of_words_; ++i)
+            for (Word word = words_[i]; word != 0; word &= word - 1)
+                function(i * word_bits + __builtin_ctzll(word));
+    }
+
+private:
+    int size_ = 0;
+    int number_of_words_ = 0;
+    std::array<Word, max_size / word_bits> words_ = {};
+};
@@ -0,0 +1,47 @@
+#include "danger_map.hpp"
+#include "tracking.hpp"
+#include "map.hpp"
+#include "tool.hpp"
+#include <algorithm>
+
+void Danger_map::init(const Map& map)
+{
+    threat_cells_.assign(map.padded_size(), Bitboard(map.padded_size()));
+    map.ocean_cells().for_each([&](int index)
+    {
+        // Ocean squares from which a torpedo fired after at most one move can blast index.
+        Bitboard& cells = threat_cells_[index];
+        cells.set(index);
+        spread_blast(map, cells);
+        cells &= map.ocean_cells();
+        for (int i = 0; i < Torpedo::max_radius() + 1; ++i)
+            spread(map, cells);
+    });
+    dangerous_cells_ = Bitboard(map.padded_size());
+    mine_blast_cells_ = Bitboard(map.padded_size());
+    dangers_.assign(map.padded_size(), 0);
+}
+
+void Danger_map::update(const Map& map, const Bitboard& opponent_positions, const Bitboard& mine_cells)
+{
+    // Blasts and torpedo paths are symmetric: the squares threatened by the possible positions
+    // are found by spreading them the same way.
+    dangerous_cells_ = opponent_positions;
+    for (int i = 0; i < Torpedo::max_radius() + 1; ++i)
+        spread(map, dangerous_cells_);
+    spread_blast(map, dangerous_cells_);
+    dangerous_cells_ &= map.ocean_cells();
+    mine_blast_cells_ = mine_cells;
+    spread_blast(map, mine_blast_cells_);
+    mine_blast_cells_ &= map.ocean_cells();
+    dangerous_cells_ |= mine_blast_cells_;
+
+    int number_of_positions = static_cast<int>(opponent_positions.count());
+    std::fill(dangers_.begin(), dangers_.end(), 0);
+    dangerous_cells_.for_each([&](int index)
+    {
+        dangers_[index] = static_cast<int>((threat_cells_[index] & opponent_positions).count());
+        if (mine_blast_cells_.test(index))
+            dangers_[index] += number_of_positions;
+    });
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "bitboard.hpp"
+#include <vector>
+
+class Map;
+
+// For each ocean square, number of the opponent's possible positions from which it can hit the
+// square with a torpedo during its next turn, after at most one move. A square in the blast of one
+// of their probable mines counts as threatened by every possible position: a mine needs no aim.
+class Danger_map
+{
+public:
+    // Precomputes, for each square, the positions threatening it.
+    void init(const Map& map);
+
+    // mine_cells: Opponent::probable_mine_cells().
+    void update(const Map& map, const Bitboard& opponent_positions, const Bitboard& mine_cells);
+
+    const Bitboard& dangerous_cells() const { return dangerous_cells_; }
+    // Squares in the blast of mine_cells: a route crosses them if its squares intersect them.
+    const Bitboard& mine_blast_cells() const { return mine_blast_cells_; }
+    int danger(int index) const { return dangers_[index]; }
+    // Indexed by cell index, 0 for safe squares.
+    const std::vector<int>& dangers() const { return dangers_; }
+
+private:
+    std::vector<Bitboard> threat_cells_;
+    Bitboard dangerous_cells_;
+    Bitboard mine_blast_cells_;
+    std::vector<int> dangers_;
+};
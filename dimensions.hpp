@@ -0,0 +1,105 @@
+#pragma once
+
+#include "vec2.hpp"
+
+inline constexpr int grid_padding() { return 1; }
+
+// Layout of a padded map whose sizes are known at compile time: every division, loop bound
+// and index offset computed from it is a constant.
+template <int Width, int Height, int Sector_width, int Sector_height>
+struct Static_dimensions
+{
+    static_assert(Width % Sector_width == 0 && Height % Sector_height == 0);
+
+    static constexpr int width() { return Width; }
+    static constexpr int height() { return Height; }
+    static constexpr int sector_width() { return Sector_width; }
+    static constexpr int sector_height() { return Sector_height; }
+    static constexpr int padding() { return grid_padding(); }
+    static constexpr int stride() { return Width + 2 * padding(); }
+    static constexpr int padded_size() { return stride() * (Height + 2 * padding()); }
+    static constexpr int number_of_sectors_on_x() { return Width / Sector_width; }
+    static constexpr int number_of_sectors_on_y() { return Height / Sector_height; }
+    static constexpr int number_of_sectors() { return number_of_sectors_on_x() * number_of_sectors_on_y(); }
+
+    static constexpr bool contains(const Vec2& pos) { return pos.x >= 0 && pos.x < Width && pos.y >= 0 && pos.y < Height; }
+    static constexpr int index(int x, int y) { return (y + padding()) * stride() + x + padding(); }
+    static constexpr int index(const Vec2& pos) { return index(pos.x, pos.y); }
+    static constexpr Vec2 position(int index) { return Vec2(index % stride() - padding(), index / stride() - padding()); }
+    static constexpr int neighbour_offset(Direction dir)
+    {
+        return dir == North ? -stride() : dir == East ? 1 : dir == South ? stride() : -1;
+    }
+
+    static constexpr int sector_index(const Vec2& pos)
+    {
+        return (pos.y / Sector_height) * number_of_sectors_on_x() + pos.x / Sector_width + 1;
+    }
+    static constexpr Vec2 sector_origin(int sector)
+    {
+        return Vec2((sector - 1) % number_of_sectors_on_x() * Sector_width, (sector - 1) / number_of_sectors_on_x() * Sector_height);
+    }
+};
+
+// Same interface as Static_dimensions for maps of any size.
+class Dynamic_dimensions
+{
+public:
+    Dynamic_dimensions() = default;
+    Dynamic_dimensions(int width, int height, int sector_width, int sector_height)
+        : width_(width), height_(height), sector_width_(sector_width), sector_height_(sector_height)
+    {}
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    int sector_width() const { return sector_width_; }
+    int sector_height() const { return sector_height_; }
+    static constexpr int padding() { return grid_padding(); }
+    int stride() const { return width_ + 2 * padding(); }
+    int padded_size() const { return stride() * (height_ + 2 * padding()); }
+    int number_of_sectors_on_x() const { return width_ / sector_width_; }
+    int number_of_sectors_on_y() const { return height_ / sector_height_; }
+    int number_of_sectors() const { return number_of_sectors_on_x() * number_of_sectors_on_y(); }
+
+    bool contains(const Vec2& pos) const { return pos.x >= 0 && pos.x < width_ && pos.y >= 0 && pos.y < height_; }
+    int index(int x, int y) const { return (y + padding()) * stride() + x + padding(); }
+    int index(const Vec2& pos) const { return index(pos.x, pos.y); }
+    Vec2 position(int index) const { return Vec2(index % stride() - padding(), index / stride() - padding()); }
+    int neighbour_offset(Direction dir) const
+    {
+        return dir == North ? -stride() : dir == East ? 1 : dir == South ? stride() : -1;
+    }
+
+    int sector_index(const Vec2& pos) const
+    {
+        return (pos.y / sector_height_) * number_of_sectors_on_x() + pos.x / sector_width_ + 1;
+    }
+    Vec2 sector_origin(int sector) const
+    {
+        return Vec2((sector - 1) % number_of_sectors_on_x() * sector_width_, (sector - 1) / number_of_sectors_on_x() * sector_height_);
+    }
+
+    template <class Static_dims>
+    bool matches() const
+    {
+        return width_ == Static_dims::width() && height_ == Static_dims::height()
+                && sector_width_ == Static_dims::sector_width() && sector_height_ == Static_dims::sector_height();
+    }
+
+private:
+    int width_ = 0;
+    int height_ = 0;
+    int sector_width_ = 1;
+    int sector_height_ = 1;
+};
+
+using Standard_dimensions = Static_dimensions<15, 15, 5, 5>;
+
+// Calls function with Standard_dimensions when the map has the standard size, with dims otherwise.
+template <class Function>
+decltype(auto) visit_dimensions(const Dynamic_dimensions& dims, bool is_standard, Function&& function)
+{
+    if (is_standard)
+        return function(Standard_dimensions());
+    return function(dims);
+}
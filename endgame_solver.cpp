@@ -0,0 +1,542 @@
+#include "endgame_solver.hpp"
+#include "tracking.hpp"
+#include "map.hpp"
+#include "tool.hpp"
+#include "zobrist.hpp"
+#include <algorithm>
+#include <cstdlib>
+
+namespace
+{
+enum Charge { No_charge, Charge_torpedo, Charge_silence, Charge_mine };
+
+// Zobrist features of the solver states, apart from our visited squares (Map::cell_key), or-ed
+// with their value. Each one has its own bits above the values and above the cell indices of
+// Map::cell_key, so that no two of them share a key whatever the kind they are hashed with.
+enum Solver_feature : uint64_t
+{
+    Our_position = 1ull << 24,
+    Their_position = 2ull << 24,
+    Their_mine = 3ull << 24,
+    Our_hp = 4ull << 24,
+    Their_hp = 5ull << 24,
+    Cooldowns = 6ull << 24 // the cooldown number << 8 | its slot
+};
+
+int cooldown_slot(int cooldown)
+{
+    return std::clamp(cooldown, 0, 15);
+}
+}
+
+uint64_t Endgame_solver::Order::code() const
+{
+    auto field = [](int value) { return static_cast<uint64_t>(value + 1) & 0xFFFF; };
+    return field(fire_before) | field(dir) << 16 | field(distance) << 20 | uint64_t(surface) << 24
+           | uint64_t(charge) << 25 | field(fire_after) << 32;
+}
+
+void Endgame_solver::init(const Map& map)
+{
+    map_ = &map;
+    neighbour_offsets_ = map.neighbour_offsets();
+    stride_ = map.stride();
+    ocean_cells_ = map.ocean_cells();
+    torpedo_range_cells_.assign(map.padded_size(), Bitboard(map.padded_size()));
+    blast_cells_.assign(map.padded_size(), Bitboard(map.padded_size()));
+    map.ocean_cells().for_each([&](int index)
+    {
+        torpedo_range_cells_[index] = torpedo_origin_cells(map, map.position(index));
+        Bitboard& cells = blast_cells_[index];
+        cells.set(index);
+        spread_blast(map, cells);
+    });
+    transposition_table_.assign(transposition_table_size, Tt_entry());
+    generation_ = 0;
+    for (std::vector<Order>& orders : orders_)
+        orders.reserve(max_number_of_orders);
+}
+
+Endgame_solver::Result Endgame_solver::solve(const Map& map, const Rollout_state& root, const std::vector<int>& their_indices,
+                                             const Bitboard& their_mine_cells, int their_mine_cooldown, Clock::time_point deadline)
+{
+    map_ = &map;
+    deadline_ = deadline;
+    is_interrupted_ = false;
+    number_of_nodes_ = 0;
+    ++generation_;
+    Result res;
+    if (their_indices.empty() || their_indices.size() > max_number_of_candidates)
+        return res;
+
+    State state;
+    state.visited = root.us.visited;
+    state.visited_key = root.us.visited_key;
+    state.index = root.us.index;
+    state.hp = root.us.hp;
+    state.torpedo_cooldown = root.us.torpedo_cooldown;
+    state.silence_cooldown = root.us.silence_cooldown;
+    for (int index : their_indices)
+        state.them.push_back(index);
+    state.their_hp = root.them.hp;
+    state.their_torpedo_cooldown = root.them.torpedo_cooldown;
+    state.their_silence_cooldown = root.them.silence_cooldown;
+    state.their_mine_cells = their_mine_cells;
+    state.their_mine_cells.for_each([&](int index) { state.their_mine_key ^= mine_key_(index); });
+    state.their_mine_cooldown = their_mine_cooldown;
+
+    for (int depth = 1; depth <= max_depth; ++depth)
+    {
+        Order order;
+        if (wins_(state, depth, &order))
+        {
+            res.is_win = true;
+            res.action = to_action_(order);
+            res.depth = depth;
+            break;
+        }
+        if (is_interrupted_)
+            break;
+    }
+    return res;
+}
+
+bool Endgame_solver::wins_(const State& state, int depth, Order* best_order)
+{
+    if (check_deadline_())
+        return false;
+    uint64_t key = key_(state);
+    Tt_entry& entry = transposition_table_[key % transposition_table_size];
+    bool is_stored = entry.generation == generation_ && entry.key == key;
+    if (is_stored && best_order == nullptr)
+    {
+        if (entry.win_depth > 0 && entry.win_depth <= depth)
+            return true;
+        if (entry.failure_depth >= depth)
+            return false;
+    }
+
+    std::vector<Order>& orders = orders_[depth];
+    generate_orders_(state, depth, orders);
+    if (is_stored && entry.best_order != 0)
+    {
+        auto iter = std::find_if(orders.begin(), orders.end(), [&](const Order& order) { return order.code() == entry.best_order; });
+        if (iter != orders.end())
+            std::rotate(orders.begin(), iter, iter + 1);
+    }
+
+    for (const Order& order : orders)
+    {
+        if (order_wins_(state, order, depth))
+        {
+            // The entry may have been replaced by a deeper node.
+            Tt_entry& win_entry = transposition_table_[key % transposition_table_size];
+            if (win_entry.generation != generation_ || win_entry.key != key)
+                win_entry = Tt_entry{ key, generation_, 0, 0, 0 };
+            win_entry.win_depth = static_cast<int8_t>(win_entry.win_depth > 0 ? std::min<int>(win_entry.win_depth, depth) : depth);
+            win_entry.best_order = order.code();
+            if (best_order)
+                *best_order = order;
+            return true;
+        }
+        if (is_interrupted_)
+            return false;
+    }
+
+    Tt_entry& failure_entry = transposition_table_[key % transposition_table_size];
+    if (failure_entry.generation != generation_ || failure_entry.key != key)
+        failure_entry = Tt_entry{ key, generation_, 0, 0, 0 };
+    failure_entry.failure_depth = static_cast<int8_t>(std::max<int>(failure_entry.failure_depth, depth));
+    return false;
+}
+
+bool Endgame_solver::order_wins_(const State& state, const Order& order, int depth)
+{
+    State next = state;
+    auto fire = [&](int target)
+    {
+        next.hp -= blast_damage_(target, next.index);
+        next.torpedo_cooldown = Torpedo::total_cooldown();
+    };
+    if (order.fire_before >= 0)
+        fire(order.fire_before);
+    if (order.surface)
+    {
+        --next.hp;
+        next.visited.clear();
+        next.visited.set(next.index);
+        next.visited_key = map_->cell_key(next.index);
+    }
+    else
+    {
+        int distance = order.distance >= 0 ? order.distance : 1;
+        for (int i = 0; i < distance; ++i)
+        {
+            next.index += neighbour_offsets_[order.dir];
+            next.visited.set(next.index);
+            next.visited_key ^= map_->cell_key(next.index);
+        }
+        if (order.distance >= 0)
+            next.silence_cooldown = Silence::total_cooldown();
+        else if (order.charge == Charge_torpedo)
+            --next.torpedo_cooldown;
+        else if (order.charge == Charge_silence)
+            --next.silence_cooldown;
+    }
+    if (order.fire_after >= 0)
+        fire(order.fire_after);
+    if (next.hp <= 0)
+        return false;
+
+    // They see the damage of our torpedo on their hit points: each group of candidates must be won.
+    int target = order.fire_before >= 0 ? order.fire_before : order.fire_after;
+    for (int damage = 0; damage <= 2; ++damage)
+    {
+        Candidates group;
+        for (int index : state.them)
+            if ((target >= 0 ? blast_damage_(target, index) : 0) == damage)
+                group.push_back(index);
+        if (group.count == 0 || state.their_hp - damage <= 0)
+            continue;
+        if (depth == 1)
+            return false;
+        next.them = group;
+        next.their_hp = state.their_hp - damage;
+        if (!wins_against_replies_(next, depth))
+            return false;
+    }
+    return true;
+}
+
+bool Endgame_solver::wins_against_replies_(const State& state, int depth)
+{
+    // A silence loses them: nothing is proven.
+    if (state.their_silence_cooldown == 0)
+        return false;
+    const Bitboard& our_blast = blast_cells_[state.index];
+    // A TRIGGER of one of their mines around us may come with any reply.
+    std::array<int, 10> triggers;
+    int number_of_triggers = 0;
+    triggers[number_of_triggers++] = -1;
+    (state.their_mine_cells & our_blast).for_each([&](int index) { triggers[number_of_triggers++] = index; });
+    Bitboard targets(our_blast.size());
+    for (int dir = -1; dir < static_cast<int>(number_of_directions()); ++dir)
+    {
+        // Charging anything else than one of their tools still to charge never helps them.
+        for (int charge : { Charge_torpedo, Charge_silence, Charge_mine })
+        {
+            if (dir < 0 && charge != Charge_torpedo)
+                continue;
+            for (bool drops_mine : { false, true })
+            {
+                if (drops_mine && state.their_mine_cooldown > 0)
+                    continue;
+                if (charge == Charge_mine && state.their_mine_cooldown == 0 && !drops_mine)
+                    continue;
+                for (int i = 0; i < number_of_triggers; ++i)
+                {
+                    Reply reply{ -1, dir, charge, -1, triggers[i], drops_mine };
+                    if (!wins_after_reply_(state, reply, depth))
+                        return false;
+                    if (state.their_torpedo_cooldown == 0)
+                    {
+                        targets.clear();
+                        for (int index : state.them)
+                            targets |= torpedo_range_cells_[index];
+                        targets &= our_blast;
+                        bool wins = true;
+                        targets.for_each([&](int target)
+                        {
+                            reply.fire_before = target;
+                            if (wins)
+                                wins = wins_after_reply_(state, reply, depth);
+                        });
+                        reply.fire_before = -1;
+                        if (!wins)
+                            return false;
+                    }
+                    int torpedo_cooldown = state.their_torpedo_cooldown - (dir >= 0 && charge == Charge_torpedo && state.their_torpedo_cooldown > 0);
+                    if (torpedo_cooldown == 0)
+                    {
+                        targets.clear();
+                        for (int index : state.them)
+                        {
+                            int destination = dir >= 0 ? index + neighbour_offsets_[dir] : index;
+                            if (ocean_cells_.test(destination))
+                                targets |= torpedo_range_cells_[destination];
+                        }
+                        targets &= our_blast;
+                        bool wins = true;
+                        targets.for_each([&](int target)
+                        {
+                            reply.fire_after = target;
+                            if (wins)
+                                wins = wins_after_reply_(state, reply, depth);
+                        });
+                        if (!wins)
+                            return false;
+                    }
+                    if (is_interrupted_)
+                        return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool Endgame_solver::wins_after_reply_(const State& state, const Reply& reply, int depth)
+{
+    if (check_deadline_())
+        return false;
+    // Candidates which can make this reply, grouped by what we see of it: their damage, and the
+    // sector of a SURFACE. A mine they drop lies next to one of the candidates of the group.
+    struct Group
+    {
+        int key;
+        Candidates candidates;
+        Bitboard mine_cells;
+    };
+    std::array<Group, max_number_of_candidates> groups;
+    int number_of_groups = 0;
+    for (int index : state.them)
+    {
+        if (reply.fire_before >= 0 && !torpedo_range_cells_[index].test(reply.fire_before))
+            continue;
+        int destination = reply.dir >= 0 ? index + neighbour_offsets_[reply.dir] : index;
+        if (!ocean_cells_.test(destination))
+            continue;
+        if (reply.fire_after >= 0 && !torpedo_range_cells_[destination].test(reply.fire_after))
+            continue;
+        int damage = reply.fire_before >= 0 ? blast_damage_(reply.fire_before, index)
+                   : reply.fire_after >= 0 ? blast_damage_(reply.fire_after, destination) : 0;
+        // They trigger before or after their MOVE, whichever hurts them less.
+        if (reply.trigger >= 0)
+            damage += std::min(blast_damage_(reply.trigger, index), blast_damage_(reply.trigger, destination));
+        int key = damage + (reply.dir < 0 ? 8 * map_->sector_of(index) : 0);
+        auto iter = std::find_if(groups.begin(), groups.begin() + number_of_groups, [&](const Group& group) { return group.key == key; });
+        if (iter == groups.begin() + number_of_groups)
+        {
+            iter->key = key;
+            iter->candidates = Candidates();
+            iter->mine_cells = Bitboard(ocean_cells_.size());
+            ++number_of_groups;
+        }
+        iter->candidates.push_back(destination);
+        if (reply.drops_mine)
+        {
+            for (int offset : neighbour_offsets_)
+            {
+                for (int origin : { index, destination })
+                    if (ocean_cells_.test(origin + offset))
+                        iter->mine_cells.set(origin + offset);
+            }
+        }
+    }
+    if (number_of_groups == 0)
+        return true; // no candidate can make it
+
+    State next = state;
+    int target = reply.fire_before >= 0 ? reply.fire_before : reply.fire_after;
+    if (target >= 0)
+    {
+        next.hp -= blast_damage_(target, state.index);
+        next.their_torpedo_cooldown = Torpedo::total_cooldown();
+    }
+    if (reply.trigger >= 0)
+    {
+        next.hp -= blast_damage_(reply.trigger, state.index);
+        next.their_mine_cells.reset(reply.trigger);
+        next.their_mine_key ^= mine_key_(reply.trigger);
+    }
+    if (next.hp <= 0)
+        return false;
+    if (reply.drops_mine)
+        next.their_mine_cooldown = Mine::total_cooldown();
+    if (reply.dir >= 0)
+    {
+        // A tool used before the MOVE may be charged again by it.
+        if (reply.charge == Charge_torpedo && next.their_torpedo_cooldown > 0)
+            --next.their_torpedo_cooldown;
+        else if (reply.charge == Charge_silence && next.their_silence_cooldown > 0)
+            --next.their_silence_cooldown;
+        else if (reply.charge == Charge_mine && next.their_mine_cooldown > 0)
+            --next.their_mine_cooldown;
+    }
+
+    const Bitboard mine_cells = next.their_mine_cells;
+    const uint64_t mine_key = next.their_mine_key;
+    for (int i = 0; i < number_of_groups; ++i)
+    {
+        const Group& group = groups[i];
+        int their_hp = state.their_hp - group.key % 8 - (reply.dir < 0);
+        if (their_hp <= 0)
+            continue;
+        next.them = group.candidates;
+        next.their_hp = their_hp;
+        next.their_mine_cells = mine_cells;
+        next.their_mine_key = mine_key;
+        if (reply.drops_mine)
+        {
+            Bitboard new_cells = group.mine_cells;
+            new_cells.subtract(mine_cells);
+            new_cells.for_each([&](int index) { next.their_mine_key ^= mine_key_(index); });
+            next.their_mine_cells |= new_cells;
+        }
+        if (!wins_(next, depth - 1))
+            return false;
+    }
+    return true;
+}
+
+void Endgame_solver::generate_orders_(const State& state, int depth, std::vector<Order>& orders) const
+{
+    orders.clear();
+    Bitboard around_them(ocean_cells_.size());
+    for (int index : state.them)
+        around_them |= blast_cells_[index];
+
+    // Movements first: MOVE with each charge, SILENCE, or SURFACE when stuck.
+    static_assert(max_number_of_movements == 4 * 2 + 4 * Silence::max_distance() + 1);
+    std::array<Order, max_number_of_movements> movements;
+    int number_of_movements = 0;
+    auto is_chargeable = [](int cooldown, int total_cooldown) { return cooldown > 0 && cooldown <= total_cooldown; };
+    for (int dir = 0; dir < static_cast<int>(number_of_directions()); ++dir)
+    {
+        int offset = neighbour_offsets_[dir];
+        if (!is_free_(state, state.index + offset))
+            continue;
+        bool charges_torpedo = is_chargeable(state.torpedo_cooldown, Torpedo::total_cooldown());
+        bool charges_silence = is_chargeable(state.silence_cooldown, Silence::total_cooldown());
+        if (charges_torpedo)
+            movements[number_of_movements++] = Order{ -1, dir, -1, false, Charge_torpedo, -1 };
+        if (charges_silence)
+            movements[number_of_movements++] = Order{ -1, dir, -1, false, Charge_silence, -1 };
+        if (!charges_torpedo && !charges_silence)
+            movements[number_of_movements++] = Order{ -1, dir, -1, false, No_charge, -1 };
+        if (state.silence_cooldown == 0)
+        {
+            int index = state.index;
+            for (int distance = 1; distance <= Silence::max_distance() && is_free_(state, index + offset); ++distance)
+            {
+                index += offset;
+                movements[number_of_movements++] = Order{ -1, dir, distance, false, No_charge, -1 };
+            }
+        }
+    }
+    if (number_of_movements == 0)
+        movements[number_of_movements++] = Order{ -1, -1, -1, true, No_charge, -1 };
+
+    // Targets hitting one of them, without sinking us.
+    auto for_each_target = [&](int index, int hp, auto&& function)
+    {
+        (torpedo_range_cells_[index] & around_them).for_each([&](int target)
+        {
+            if (blast_damage_(target, index) < hp)
+                function(target);
+        });
+    };
+    auto destination = [&](const Order& movement)
+    {
+        if (movement.surface)
+            return state.index;
+        return state.index + neighbour_offsets_[movement.dir] * (movement.distance >= 0 ? movement.distance : 1);
+    };
+    for (int i = 0; i < number_of_movements; ++i)
+    {
+        const Order& movement = movements[i];
+        int hp_after_movement = state.hp - movement.surface;
+        // Only a torpedo sinks them at the last turn.
+        if (depth > 1)
+            orders.push_back(movement);
+        if (state.torpedo_cooldown == 0)
+        {
+            for_each_target(state.index, hp_after_movement, [&](int target)
+            {
+                orders.push_back(movement);
+                orders.back().fire_before = target;
+            });
+        }
+        bool is_charged = state.torpedo_cooldown == 0 || (state.torpedo_cooldown == 1 && movement.charge == Charge_torpedo);
+        if (is_charged)
+        {
+            for_each_target(destination(movement), hp_after_movement, [&](int target)
+            {
+                orders.push_back(movement);
+                orders.back().fire_after = target;
+            });
+        }
+    }
+
+    // Most damage first, then closest to them.
+    auto priority = [&](const Order& order)
+    {
+        int target = order.fire_before >= 0 ? order.fire_before : order.fire_after;
+        int damage = 0;
+        int distance = 0;
+        int index = destination(order);
+        for (int candidate : state.them)
+        {
+            if (target >= 0)
+                damage += blast_damage_(target, candidate);
+            distance += std::abs(index % stride_ - candidate % stride_) + std::abs(index / stride_ - candidate / stride_);
+        }
+        return damage * 1024 - distance;
+    };
+    // The code breaks ties: the order is the same in every run (std::stable_sort would allocate).
+    std::sort(orders.begin(), orders.end(), [&](const Order& lhs, const Order& rhs)
+    {
+        int lhs_priority = priority(lhs);
+        int rhs_priority = priority(rhs);
+        return lhs_priority != rhs_priority ? lhs_priority > rhs_priority : lhs.code() < rhs.code();
+    });
+}
+
+Rollout_action Endgame_solver::to_action_(const Order& order) const
+{
+    Rollout_action action;
+    int target = order.fire_before >= 0 ? order.fire_before : order.fire_after;
+    if (target >= 0)
+        action.torpedo_target = map_->position(target);
+    action.fires_after_move = order.fire_after >= 0;
+    action.dir = order.dir >= 0 ? Direction(order.dir) : Undefined;
+    action.silence_distance = order.distance;
+    action.surface = order.surface;
+    action.charge = order.charge == Charge_torpedo ? "TORPEDO" : order.charge == Charge_silence ? "SILENCE" : "";
+    return action;
+}
+
+uint64_t Endgame_solver::key_(const State& state) const
+{
+    uint64_t res = state.visited_key ^ zobrist::key(zobrist::Position, Our_position | static_cast<uint64_t>(state.index));
+    for (int index : state.them)
+        res ^= zobrist::key(zobrist::Position, Their_position | static_cast<uint64_t>(index));
+    res ^= zobrist::key(zobrist::Hp, Our_hp | static_cast<uint64_t>(std::max(state.hp, 0)));
+    res ^= zobrist::key(zobrist::Hp, Their_hp | static_cast<uint64_t>(std::max(state.their_hp, 0)));
+    res ^= state.their_mine_key;
+    int cooldowns[] = { state.torpedo_cooldown, state.silence_cooldown, state.their_torpedo_cooldown, state.their_silence_cooldown,
+                        state.their_mine_cooldown };
+    for (uint64_t i = 0; i < 5; ++i)
+        res ^= zobrist::key(zobrist::Cooldown, Cooldowns | i << 8 | static_cast<uint64_t>(cooldown_slot(cooldowns[i])));
+    return res;
+}
+
+uint64_t Endgame_solver::mine_key_(int index) const
+{
+    return zobrist::key(zobrist::Cell, Their_mine | static_cast<uint64_t>(index));
+}
+
+int Endgame_solver::blast_damage_(int target_index, int index) const
+{
+    int dx = std::abs(target_index % stride_ - index % stride_);
+    int dy = std::abs(target_index / stride_ - index / stride_);
+    int distance = std::max(dx, dy);
+    return distance == 0 ? 2 : distance == 1 ? 1 : 0;
+}
+
+bool Endgame_solver::check_deadline_()
+{
+    if ((++number_of_nodes_ & 63) == 0 && Clock::now() >= deadline_)
+        is_interrupted_ = true;
+    return is_interrupted_;
+}
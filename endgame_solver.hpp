@@ -0,0 +1,149 @@
+#pragma once
+
+#include "rollout.hpp"
+#include "bitboard.hpp"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+class Map;
+
+// Exact solver of the endgames where the opponent is located up to a handful of candidates: it
+// looks for a combined action that sinks them by force within a few turns, whatever they do.
+//
+// The search is an AND-OR search, alpha-beta with a null window around a win:
+// - our turn: a MOVE (charging the torpedo or the silence), a SILENCE or the SURFACE when stuck,
+//   with a torpedo before or after it; at the last turn, only the actions firing a torpedo,
+// - the damage of our torpedo is seen on their hit points: the candidates are split by damage,
+//   and each group must be won,
+// - their turn: any MOVE or torpedo which one of the candidates can make, with a TRIGGER of any of
+//   their possible mines around us and a MINE dropped next to them, the other candidates being
+//   ruled out by what we see of it. They see where we are.
+// They have no trail (any ocean square is free for them), and their cooldowns are lower bounds:
+// a silence they can use ends the proof, since it loses them. So a win is a true win.
+//
+// Proven wins and failures are stored by depth in a fixed-size transposition table keyed by
+// Zobrist keys, with the action which won for the move ordering. The depth (number of our turns)
+// is deepened until the deadline or the first win.
+class Endgame_solver
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    inline static constexpr std::size_t max_number_of_candidates = 4;
+    inline static constexpr int max_depth = 6;
+    inline static constexpr std::size_t transposition_table_size = 1 << 16;
+    // MOVE with each charge or SILENCE in each direction, or SURFACE.
+    inline static constexpr int max_number_of_movements = 4 * 2 + 4 * 4 + 1;
+    // Each movement alone, then with a torpedo before or after it at a square next to them.
+    inline static constexpr int max_number_of_orders = max_number_of_movements * (1 + 2 * 9 * static_cast<int>(max_number_of_candidates));
+
+    struct Result
+    {
+        bool is_win = false;
+        Rollout_action action;
+        int depth = 0; // number of our turns to sink them, if is_win
+    };
+
+    void init(const Map& map);
+
+    // root.them.index is ignored: they are at one of their_indices (at most max_number_of_candidates).
+    // Their mines may lie on their_mine_cells; their_mine_cooldown is a lower bound, as the others.
+    Result solve(const Map& map, const Rollout_state& root, const std::vector<int>& their_indices,
+                 const Bitboard& their_mine_cells, int their_mine_cooldown, Clock::time_point deadline);
+    std::size_t number_of_nodes() const { return number_of_nodes_; }
+
+private:
+    struct Candidates
+    {
+        std::array<int16_t, max_number_of_candidates> indices = {};
+        int count = 0;
+
+        void push_back(int index) { indices[count++] = static_cast<int16_t>(index); }
+        const int16_t* begin() const { return indices.data(); }
+        const int16_t* end() const { return indices.data() + count; }
+    };
+
+    struct State
+    {
+        Bitboard visited; // ours
+        uint64_t visited_key = 0;
+        int index = 0;
+        int hp = 0;
+        int torpedo_cooldown = 0;
+        int silence_cooldown = 0;
+        Candidates them;
+        int their_hp = 0;
+        int their_torpedo_cooldown = 0;
+        int their_silence_cooldown = 0;
+        Bitboard their_mine_cells;
+        uint64_t their_mine_key = 0;
+        int their_mine_cooldown = 0;
+    };
+
+    // One of our combined actions.
+    struct Order
+    {
+        int fire_before = -1; // target index
+        int dir = -1;
+        int distance = -1; // SILENCE if >= 0
+        bool surface = false;
+        int charge = 0; // 0: none, 1: torpedo, 2: silence
+        int fire_after = -1;
+
+        uint64_t code() const; // never 0
+    };
+
+    // One of their replies.
+    struct Reply
+    {
+        int fire_before = -1; // target index
+        int dir = -1; // SURFACE if negative
+        int charge = 0; // 0: none, 1: torpedo, 2: silence, 3: mine
+        int fire_after = -1;
+        int trigger = -1; // index of the mine triggered
+        bool drops_mine = false;
+    };
+
+    struct Tt_entry
+    {
+        uint64_t key = 0;
+        uint32_t generation = 0;
+        int8_t win_depth = 0; // won at this depth and deeper, 0 if not proven
+        int8_t failure_depth = 0; // not won at this depth or shallower
+        uint64_t best_order = 0;
+    };
+
+    // True if we win from state, our turn, in depth turns of ours at most. The winning order is
+    // written to best_order if given (the transposition table is then only used for the ordering).
+    bool wins_(const State& state, int depth, Order* best_order = nullptr);
+    // True if we win in every group of candidates left after our order.
+    bool order_wins_(const State& state, const Order& order, int depth);
+    // Their turn: true if we win after each of their replies.
+    bool wins_against_replies_(const State& state, int depth);
+    // After their reply, made by one of the candidates.
+    bool wins_after_reply_(const State& state, const Reply& reply, int depth);
+
+    void generate_orders_(const State& state, int depth, std::vector<Order>& orders) const;
+    Rollout_action to_action_(const Order& order) const;
+    uint64_t key_(const State& state) const;
+    uint64_t mine_key_(int index) const;
+    bool is_free_(const State& state, int index) const { return ocean_cells_.test(index) && !state.visited.test(index); }
+    int blast_damage_(int target_index, int index) const;
+    bool check_deadline_();
+
+    std::array<int, 4> neighbour_offsets_ = {};
+    int stride_ = 0;
+    const Map* map_ = nullptr;
+    Bitboard ocean_cells_;
+    std::vector<Bitboard> torpedo_range_cells_; // [index]: squares a torpedo fired from index can reach
+    std::vector<Bitboard> blast_cells_; // [index]: the 3x3 square centered on index
+    std::vector<Tt_entry> transposition_table_;
+    uint32_t generation_ = 0;
+    // Orders of each depth, kept to avoid allocations.
+    std::array<std::vector<Order>, max_depth + 1> orders_;
+
+    Clock::time_point deadline_;
+    bool is_interrupted_ = false;
+    std::size_t number_of_nodes_ = 0;
+};
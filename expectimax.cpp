@@ -0,0 +1,472 @@
+#include "expectimax.hpp"
+#include "tracking.hpp"
+#include "opponent.hpp"
+#include "map.hpp"
+#include "tool.hpp"
+#include "zobrist.hpp"
+#include <algorithm>
+#include <cstdlib>
+
+namespace
+{
+// Value of a charged tool at a leaf: what is left of the torpedo or silence we could use next.
+constexpr double charged_tool_value = 0.25;
+// Values closer than this are equal: the first action is kept.
+constexpr double value_epsilon = 1e-9;
+
+template <std::size_t N>
+int slot(int value, const std::array<uint64_t, N>&)
+{
+    return std::clamp(value, 0, static_cast<int>(N) - 1);
+}
+
+// Chances that a torpedo aimed at one of exposure positions hits its target directly, and blasts it.
+double direct_hit_probability(int exposure)
+{
+    return 1. / std::max(exposure, 1);
+}
+
+double blast_probability(int exposure)
+{
+    return std::min(std::max(exposure, 1) - 1, 8) / static_cast<double>(std::max(exposure, 1));
+}
+}
+
+void Expectimax_search::init(const Map& map)
+{
+    map_ = &map;
+    neighbour_offsets_ = map.neighbour_offsets();
+    stride_ = map.stride();
+    ocean_cells_ = map.ocean_cells();
+    number_of_ocean_cells_ = std::max<int>(map.ocean_cells().count(), 1);
+    number_of_sectors_ = map.dimensions().number_of_sectors();
+    torpedo_range_cells_.assign(map.padded_size(), Bitboard(map.padded_size()));
+    torpedo_range_sizes_.assign(map.padded_size(), 0);
+    map.ocean_cells().for_each([&](int index)
+    {
+        torpedo_range_cells_[index] = torpedo_origin_cells(map, map.position(index));
+        torpedo_range_sizes_[index] = static_cast<int>(torpedo_range_cells_[index].count());
+    });
+
+    // Our visited squares are keyed as on the map, so that the key of the root is Map::visit_key().
+    for (Side side : { Us, Them })
+    {
+        Side_keys& keys = keys_[side];
+        uint64_t side_bit = static_cast<uint64_t>(side) << 32;
+        keys.position.resize(map.padded_size());
+        keys.visited.resize(map.padded_size());
+        for (std::size_t i = 0; i < keys.position.size(); ++i)
+        {
+            keys.position[i] = zobrist::key(zobrist::Position, side_bit | i);
+            keys.visited[i] = side == Us ? map.cell_key(static_cast<int>(i)) : zobrist::key(zobrist::Cell, side_bit | i);
+        }
+        for (std::size_t i = 0; i < keys.hp.size(); ++i)
+            keys.hp[i] = zobrist::key(zobrist::Hp, side_bit | i);
+        for (std::size_t i = 0; i < keys.torpedo_cooldown.size(); ++i)
+        {
+            keys.torpedo_cooldown[i] = zobrist::key(zobrist::Cooldown, side_bit | i);
+            keys.silence_cooldown[i] = zobrist::key(zobrist::Cooldown, side_bit | 1 << 8 | i);
+        }
+        for (std::size_t i = 0; i < keys.exposure.size(); ++i)
+            keys.exposure[i] = zobrist::key(zobrist::Exposure, side_bit | i);
+    }
+    for (std::size_t depth = 0; depth < depth_keys_.size(); ++depth)
+        depth_keys_[depth] = zobrist::key(zobrist::Search_depth, depth);
+    transposition_table_.assign(transposition_table_size, Tt_entry());
+    generation_ = 0;
+    chance_positions_.reserve(max_number_of_chance_positions);
+}
+
+Expectimax_search::Result Expectimax_search::search(const Map& map, const Rollout_state& root, const Opponent& opponent,
+                                                    const Turn_vector<Rollout_action>& actions, Clock::time_point deadline)
+{
+    map_ = &map;
+    root_ = root;
+    deadline_ = deadline;
+    is_interrupted_ = false;
+    number_of_nodes_ = 0;
+    // Values depend on the chance positions of the root: entries of the last search are stale.
+    ++generation_;
+    Result res;
+    if (actions.empty())
+        return res;
+    res.action = actions.front();
+    select_chance_positions_(opponent);
+    if (chance_positions_.empty())
+        return res;
+
+    for (int depth = 1; depth <= max_depth; ++depth)
+    {
+        Result best;
+        bool has_best = false;
+        for (const Rollout_action& action : actions)
+        {
+            double value = action_value_(action, depth);
+            if (is_interrupted_)
+                return res;
+            if (!has_best || value > best.value + value_epsilon)
+            {
+                best.action = action;
+                best.value = value;
+                has_best = true;
+            }
+        }
+        best.depth = depth;
+        res = best;
+    }
+    return res;
+}
+
+void Expectimax_search::select_chance_positions_(const Opponent& opponent)
+{
+    chance_positions_.clear();
+    uint64_t total_weight = opponent.total_weight();
+    if (total_weight == 0)
+        return;
+    const auto& candidates = opponent.candidate_indices();
+    if (candidates.size() <= max_number_of_chance_positions)
+    {
+        for (int index : candidates)
+            if (opponent.weight(index) > 0)
+                chance_positions_.push_back(Chance_position{ index, static_cast<double>(opponent.weight(index)) / total_weight });
+        return;
+    }
+    // One position at the middle of each of max_number_of_chance_positions equal slices of the
+    // cumulative weights: a heavy candidate may stand for several slices.
+    double slice_probability = 1. / max_number_of_chance_positions;
+    auto candidate_iter = candidates.begin();
+    uint64_t cumulative_weight = opponent.weight(*candidate_iter);
+    for (std::size_t i = 0; i < max_number_of_chance_positions; ++i)
+    {
+        uint64_t quantile = (2 * i + 1) * total_weight / (2 * max_number_of_chance_positions);
+        while (cumulative_weight <= quantile && candidate_iter + 1 != candidates.end())
+            cumulative_weight += opponent.weight(*++candidate_iter);
+        if (!chance_positions_.empty() && chance_positions_.back().index == *candidate_iter)
+            chance_positions_.back().probability += slice_probability;
+        else
+            chance_positions_.push_back(Chance_position{ *candidate_iter, slice_probability });
+    }
+}
+
+double Expectimax_search::action_value_(const Rollout_action& action, int depth)
+{
+    double res = 0;
+    for (const Chance_position& chance_position : chance_positions_)
+    {
+        Node node;
+        node.state = root_;
+        node.state.them.index = chance_position.index;
+        node.state.them.visited.set(chance_position.index);
+        node.key = key_(node.state);
+
+        // Our torpedo first: its target is chosen, it hits where it is aimed.
+        if (action.fires_torpedo())
+        {
+            int target_index = map_->index(action.torpedo_target);
+            set_hp_(node, Us, node.state.us.hp - blast_damage_(target_index, node.state.us.index));
+            set_hp_(node, Them, node.state.them.hp - blast_damage_(target_index, node.state.them.index));
+            set_torpedo_cooldown_(node, Us, Torpedo::total_cooldown());
+            set_exposure_(node, Us, std::min(node.state.us.exposure, torpedo_range_sizes_[target_index]));
+        }
+        if (!is_over_(node.state))
+        {
+            if (action.surface)
+                surface_(node, Us);
+            else if (dir_is_valid(action.dir))
+            {
+                int distance = action.is_silence() ? action.silence_distance : 1;
+                for (int i = 0; i < distance; ++i)
+                    move_(node, Us, node.state.us.index + neighbour_offsets_[action.dir]);
+                if (action.is_silence())
+                {
+                    set_silence_cooldown_(node, Us, Silence::total_cooldown());
+                    set_exposure_(node, Us, std::min(node.state.us.exposure * (2 * Silence::max_distance() + 1), number_of_ocean_cells_));
+                }
+                else
+                    charge_(node, Us, action.charge);
+            }
+        }
+
+        double value = is_over_(node.state) ? leaf_value_(node.state) : their_turn_(node, depth);
+        if (is_interrupted_)
+            return 0;
+        res += chance_position.probability * value;
+    }
+    return res;
+}
+
+double Expectimax_search::our_turn_(const Node& node, int depth)
+{
+    if (depth == 0 || is_over_(node.state))
+        return leaf_value_(node.state);
+    if (check_deadline_())
+        return 0;
+
+    uint64_t key = node.key ^ depth_keys_[depth];
+    Tt_entry& entry = transposition_table_[key % transposition_table_size];
+    if (entry.generation == generation_ && entry.key == key)
+        return entry.value;
+
+    const Rollout_state::Submarine& us = node.state.us;
+    const Rollout_state::Submarine& them = node.state.them;
+
+    // Outcomes of our torpedo, if we fire one: aimed as in the playouts.
+    struct Outcome
+    {
+        Node node;
+        double probability;
+    };
+    std::array<Outcome, 3> outcomes;
+    outcomes[0] = Outcome{ node, 1. };
+    bool can_fire = us.torpedo_cooldown == 0 && torpedo_range_cells_[us.index].test(them.index)
+                    && blast_damage_(them.index, us.index) == 0;
+
+    double res = 0;
+    bool has_res = false;
+    for (int fires = 0; fires <= static_cast<int>(can_fire); ++fires)
+    {
+        int number_of_outcomes = 1;
+        if (fires)
+        {
+            double direct_probability = direct_hit_probability(them.exposure);
+            double blast_probability_ = blast_probability(them.exposure);
+            std::array<std::pair<int, double>, 3> hits = {{ { 2, direct_probability }, { 1, blast_probability_ },
+                                                            { 0, 1. - direct_probability - blast_probability_ } }};
+            number_of_outcomes = 0;
+            for (const auto& [damage, probability] : hits)
+            {
+                if (probability <= 0.)
+                    continue;
+                Outcome& outcome = outcomes[number_of_outcomes++];
+                outcome.node = node;
+                outcome.probability = probability;
+                set_hp_(outcome.node, Them, them.hp - damage);
+                set_torpedo_cooldown_(outcome.node, Us, Torpedo::total_cooldown());
+                set_exposure_(outcome.node, Us, std::min(us.exposure, torpedo_range_sizes_[them.index]));
+            }
+        }
+
+        bool is_stuck = true;
+        for (int offset : neighbour_offsets_)
+        {
+            int nindex = us.index + offset;
+            if (!ocean_cells_.test(nindex) || us.visited.test(nindex))
+                continue;
+            is_stuck = false;
+            double value = 0;
+            for (int i = 0; i < number_of_outcomes; ++i)
+            {
+                const Outcome& outcome = outcomes[i];
+                if (is_over_(outcome.node.state))
+                {
+                    value += outcome.probability * leaf_value_(outcome.node.state);
+                    continue;
+                }
+                Node child = outcome.node;
+                move_(child, Us, nindex);
+                charge_(child, Us);
+                value += outcome.probability * their_turn_(child, depth);
+            }
+            if (is_interrupted_)
+                return 0;
+            if (!has_res || value > res)
+                res = value;
+            has_res = true;
+        }
+        if (is_stuck)
+        {
+            double value = 0;
+            for (int i = 0; i < number_of_outcomes; ++i)
+            {
+                const Outcome& outcome = outcomes[i];
+                Node child = outcome.node;
+                if (!is_over_(child.state))
+                    surface_(child, Us);
+                value += outcome.probability * (is_over_(child.state) ? leaf_value_(child.state) : their_turn_(child, depth));
+            }
+            if (is_interrupted_)
+                return 0;
+            if (!has_res || value > res)
+                res = value;
+            has_res = true;
+        }
+    }
+
+    entry.key = key;
+    entry.generation = generation_;
+    entry.value = res;
+    return res;
+}
+
+double Expectimax_search::their_turn_(const Node& node, int depth)
+{
+    if (check_deadline_())
+        return 0;
+    const Rollout_state::Submarine& us = node.state.us;
+    const Rollout_state::Submarine& them = node.state.them;
+    double res = 0;
+    double hold_probability = 1.;
+    // They fire, as in the playouts, when the position they aim at is in our 3x3 square, and never in their own blast.
+    if (them.torpedo_cooldown == 0 && torpedo_range_cells_[them.index].test(us.index) && blast_damage_(us.index, them.index) == 0)
+    {
+        double direct_probability = direct_hit_probability(us.exposure);
+        double blast_probability_ = blast_probability(us.exposure);
+        hold_probability = std::max(1. - direct_probability - blast_probability_, 0.);
+        for (const auto& [damage, probability] : { std::pair<int, double>{ 2, direct_probability }, std::pair<int, double>{ 1, blast_probability_ } })
+        {
+            if (probability <= 0.)
+                continue;
+            Node child = node;
+            set_hp_(child, Us, us.hp - damage);
+            set_torpedo_cooldown_(child, Them, Torpedo::total_cooldown());
+            set_exposure_(child, Them, std::min(them.exposure, torpedo_range_sizes_[us.index]));
+            res += probability * (is_over_(child.state) ? leaf_value_(child.state) : their_move_(child, depth));
+        }
+    }
+    if (hold_probability > 0.)
+        res += hold_probability * their_move_(node, depth);
+    return is_interrupted_ ? 0 : res;
+}
+
+double Expectimax_search::their_move_(const Node& node, int depth)
+{
+    const Rollout_state::Submarine& them = node.state.them;
+    double res = 0;
+    int number_of_moves = 0;
+    for (int offset : neighbour_offsets_)
+    {
+        int nindex = them.index + offset;
+        if (!ocean_cells_.test(nindex) || them.visited.test(nindex))
+            continue;
+        Node child = node;
+        move_(child, Them, nindex);
+        charge_(child, Them);
+        res += our_turn_(child, depth - 1);
+        ++number_of_moves;
+        if (is_interrupted_)
+            return 0;
+    }
+    if (number_of_moves > 0)
+        return res / number_of_moves;
+
+    Node child = node;
+    surface_(child, Them);
+    return is_over_(child.state) ? leaf_value_(child.state) : our_turn_(child, depth - 1);
+}
+
+double Expectimax_search::leaf_value_(const Rollout_state& state) const
+{
+    double res = std::max(state.us.hp, 0) - std::max(state.them.hp, 0);
+    if (state.them.hp <= 0)
+        res += Rollout_engine::sunk_bonus;
+    if (state.us.hp <= 0)
+        res -= Rollout_engine::sunk_bonus;
+    res += charged_tool_value * ((state.us.torpedo_cooldown == 0) - (state.them.torpedo_cooldown == 0));
+    res += charged_tool_value * (state.us.silence_cooldown == 0);
+    return res;
+}
+
+bool Expectimax_search::check_deadline_()
+{
+    if ((++number_of_nodes_ & 255) == 0 && Clock::now() >= deadline_)
+        is_interrupted_ = true;
+    return is_interrupted_;
+}
+
+uint64_t Expectimax_search::key_(const Rollout_state& state) const
+{
+    uint64_t res = 0;
+    for (Side side : { Us, Them })
+    {
+        const Side_keys& keys = keys_[side];
+        const Rollout_state::Submarine& submarine = side == Us ? state.us : state.them;
+        res ^= keys.position[submarine.index];
+        if (side == Us)
+            res ^= submarine.visited_key;
+        else
+            submarine.visited.for_each([&](int index) { res ^= keys.visited[index]; });
+        res ^= keys.hp[slot(submarine.hp, keys.hp)];
+        res ^= keys.torpedo_cooldown[slot(submarine.torpedo_cooldown, keys.torpedo_cooldown)];
+        res ^= keys.silence_cooldown[slot(submarine.silence_cooldown, keys.silence_cooldown)];
+        res ^= keys.exposure[slot(submarine.exposure, keys.exposure)];
+    }
+    return res;
+}
+
+void Expectimax_search::move_(Node& node, Side side, int index) const
+{
+    Rollout_state::Submarine& submarine = submarine_(node, side);
+    const Side_keys& keys = keys_[side];
+    node.key ^= keys.position[submarine.index] ^ keys.position[index];
+    submarine.index = index;
+    if (!submarine.visited.test(index))
+    {
+        submarine.visited.set(index);
+        node.key ^= keys.visited[index];
+    }
+}
+
+void Expectimax_search::surface_(Node& node, Side side) const
+{
+    Rollout_state::Submarine& submarine = submarine_(node, side);
+    const Side_keys& keys = keys_[side];
+    submarine.visited.for_each([&](int index) { node.key ^= keys.visited[index]; });
+    submarine.visited.clear();
+    submarine.visited.set(submarine.index);
+    node.key ^= keys.visited[submarine.index];
+    set_hp_(node, side, submarine.hp - 1);
+    set_exposure_(node, side, std::min(submarine.exposure, number_of_ocean_cells_ / number_of_sectors_ + 1));
+}
+
+void Expectimax_search::charge_(Node& node, Side side, std::string_view charge) const
+{
+    Rollout_state::Submarine& submarine = submarine_(node, side);
+    if (charge == "SILENCE" && submarine.silence_cooldown > 0)
+        set_silence_cooldown_(node, side, submarine.silence_cooldown - 1);
+    else if (submarine.torpedo_cooldown > 0)
+        set_torpedo_cooldown_(node, side, submarine.torpedo_cooldown - 1);
+    else if (submarine.silence_cooldown > 0)
+        set_silence_cooldown_(node, side, submarine.silence_cooldown - 1);
+}
+
+void Expectimax_search::set_hp_(Node& node, Side side, int hp) const
+{
+    Rollout_state::Submarine& submarine = submarine_(node, side);
+    const Side_keys& keys = keys_[side];
+    node.key ^= keys.hp[slot(submarine.hp, keys.hp)] ^ keys.hp[slot(hp, keys.hp)];
+    submarine.hp = hp;
+}
+
+void Expectimax_search::set_torpedo_cooldown_(Node& node, Side side, int cooldown) const
+{
+    Rollout_state::Submarine& submarine = submarine_(node, side);
+    const Side_keys& keys = keys_[side];
+    node.key ^= keys.torpedo_cooldown[slot(submarine.torpedo_cooldown, keys.torpedo_cooldown)]
+                ^ keys.torpedo_cooldown[slot(cooldown, keys.torpedo_cooldown)];
+    submarine.torpedo_cooldown = cooldown;
+}
+
+void Expectimax_search::set_silence_cooldown_(Node& node, Side side, int cooldown) const
+{
+    Rollout_state::Submarine& submarine = submarine_(node, side);
+    const Side_keys& keys = keys_[side];
+    node.key ^= keys.silence_cooldown[slot(submarine.silence_cooldown, keys.silence_cooldown)]
+                ^ keys.silence_cooldown[slot(cooldown, keys.silence_cooldown)];
+    submarine.silence_cooldown = cooldown;
+}
+
+void Expectimax_search::set_exposure_(Node& node, Side side, int exposure) const
+{
+    Rollout_state::Submarine& submarine = submarine_(node, side);
+    const Side_keys& keys = keys_[side];
+    node.key ^= keys.exposure[slot(submarine.exposure, keys.exposure)] ^ keys.exposure[slot(exposure, keys.exposure)];
+    submarine.exposure = exposure;
+}
+
+int Expectimax_search::blast_damage_(int target_index, int index) const
+{
+    int dx = std::abs(target_index % stride_ - index % stride_);
+    int dy = std::abs(target_index / stride_ - index / stride_);
+    int distance = std::max(dx, dy);
+    return distance == 0 ? 2 : distance == 1 ? 1 : 0;
+}
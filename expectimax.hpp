@@ -0,0 +1,128 @@
+#pragma once
+
+#include "rollout.hpp"
+#include "bitboard.hpp"
+#include "memory.hpp"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+class Map;
+class Opponent;
+
+// Shallow expectimax search of our combined action for the turn (torpedo, MOVE, SILENCE or SURFACE,
+// and the tool charged by a MOVE), on the compact state of the playouts:
+// - the root is a chance node over the position of the opponent: the candidates of the tracker,
+//   or a sample of them stratified by weight when there are too many,
+// - then, the position being fixed in each branch, our turns are max nodes (a MOVE in any free
+//   direction, or the SURFACE, with or without a torpedo at them) and theirs are chance nodes
+//   (a torpedo at us when charged and in range, then a MOVE at random, SURFACE when stuck),
+// - a torpedo is aimed as in the playouts: a direct hit 1 chance in the exposure of the target,
+//   a blast 8 more, which makes it a chance node too; only the torpedo of our root action, whose
+//   target is chosen, hits where it is aimed.
+// A leaf is worth the difference of hit points, a sunk submarine counting for more.
+//
+// Max nodes are stored in a fixed-size transposition table keyed by a Zobrist hash of the compact
+// state, updated incrementally along the moves. The depth (the number of turns of the opponent) is
+// deepened iteratively until the deadline: the result is the best action of the last depth completed.
+class Expectimax_search
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    inline static constexpr std::size_t max_number_of_chance_positions = 16;
+    inline static constexpr std::size_t transposition_table_size = 1 << 16;
+    inline static constexpr int max_depth = 8;
+
+    struct Result
+    {
+        Rollout_action action;
+        double value = 0;
+        int depth = 0; // last depth completed, 0 if none
+    };
+
+    void init(const Map& map);
+
+    // The best of actions (the first one if no depth is completed before deadline).
+    Result search(const Map& map, const Rollout_state& root, const Opponent& opponent,
+                  const Turn_vector<Rollout_action>& actions, Clock::time_point deadline);
+    std::size_t number_of_nodes() const { return number_of_nodes_; }
+
+private:
+    enum Side { Us, Them };
+
+    struct Node
+    {
+        Rollout_state state;
+        uint64_t key = 0;
+    };
+
+    struct Chance_position
+    {
+        int index;
+        double probability;
+    };
+
+    struct Tt_entry
+    {
+        uint64_t key = 0;
+        uint32_t generation = 0;
+        double value = 0;
+    };
+
+    struct Side_keys
+    {
+        std::vector<uint64_t> position;
+        std::vector<uint64_t> visited;
+        std::array<uint64_t, 8> hp = {};
+        std::array<uint64_t, 8> torpedo_cooldown = {};
+        std::array<uint64_t, 8> silence_cooldown = {};
+        std::array<uint64_t, 256> exposure = {};
+    };
+
+    void select_chance_positions_(const Opponent& opponent);
+    double action_value_(const Rollout_action& action, int depth);
+    // Our turn: the best MOVE (or SURFACE), after a torpedo or not.
+    double our_turn_(const Node& node, int depth);
+    // Their turn: a torpedo at us or not, then their MOVE at random.
+    double their_turn_(const Node& node, int depth);
+    double their_move_(const Node& node, int depth);
+    double leaf_value_(const Rollout_state& state) const;
+    bool is_over_(const Rollout_state& state) const { return state.us.hp <= 0 || state.them.hp <= 0; }
+    // Counts a node; true once the deadline is passed.
+    bool check_deadline_();
+
+    // State updates, with the key. key_() is for the states of the turn: our visited squares are
+    // keyed by their Rollout_state::Submarine::visited_key.
+    uint64_t key_(const Rollout_state& state) const;
+    Rollout_state::Submarine& submarine_(Node& node, Side side) const { return side == Us ? node.state.us : node.state.them; }
+    void move_(Node& node, Side side, int index) const;
+    void surface_(Node& node, Side side) const;
+    void charge_(Node& node, Side side, std::string_view charge = {}) const;
+    void set_hp_(Node& node, Side side, int hp) const;
+    void set_torpedo_cooldown_(Node& node, Side side, int cooldown) const;
+    void set_silence_cooldown_(Node& node, Side side, int cooldown) const;
+    void set_exposure_(Node& node, Side side, int exposure) const;
+    int blast_damage_(int target_index, int index) const;
+
+    const Map* map_ = nullptr;
+    std::array<int, 4> neighbour_offsets_ = {};
+    int stride_ = 0;
+    Bitboard ocean_cells_;
+    int number_of_ocean_cells_ = 1;
+    int number_of_sectors_ = 1;
+    std::vector<Bitboard> torpedo_range_cells_; // [index]: squares a torpedo fired from index can reach
+    std::vector<int> torpedo_range_sizes_;
+    std::array<Side_keys, 2> keys_;
+    std::array<uint64_t, max_depth + 1> depth_keys_ = {};
+    std::vector<Tt_entry> transposition_table_;
+    uint32_t generation_ = 0;
+
+    // Per search.
+    Rollout_state root_;
+    std::vector<Chance_position> chance_positions_;
+    Clock::time_point deadline_;
+    bool is_interrupted_ = false;
+    std::size_t number_of_nodes_ = 0;
+};
@@ -0,0 +1,57 @@
+#include "exposure_tracker.hpp"
+#include "tracking.hpp"
+#include "map.hpp"
+
+void Exposure_tracker::init(const Map& map)
+{
+    positions_ = map.ocean_cells();
+    count_ = positions_.count();
+    path_.clear();
+    path_.reserve(map.padded_size());
+}
+
+void Exposure_tracker::update_with_move(const Map& map, Direction dir)
+{
+    path_.push_back(dir);
+    Bitboard positions = positions_;
+    propagate_move(map, positions, dir);
+    set_positions_(positions);
+}
+
+void Exposure_tracker::update_with_silence(const Map& map)
+{
+    path_.push_back(Undefined);
+    Bitboard positions = positions_;
+    propagate_silence(map, positions, relative_trail_rays(path_));
+    set_positions_(positions);
+}
+
+void Exposure_tracker::update_with_surface(const Map& map, int sector)
+{
+    path_.clear();
+    set_positions_(positions_ & map.sector_cells(sector));
+}
+
+void Exposure_tracker::update_with_torpedo(const Map& map, const Position& target)
+{
+    set_positions_(positions_ & torpedo_origin_cells(map, target));
+}
+
+void Exposure_tracker::update_with_sonar(const Map& map, int sector, bool found)
+{
+    Bitboard positions = positions_;
+    if (found)
+        positions &= map.sector_cells(sector);
+    else
+        positions.subtract(map.sector_cells(sector));
+    set_positions_(positions);
+}
+
+void Exposure_tracker::set_positions_(const Bitboard& positions)
+{
+    std::size_t count = positions.count();
+    if (count == 0)
+        return;
+    positions_ = positions;
+    count_ = count;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "bitboard.hpp"
+#include "direction.hpp"
+#include "grid.hpp"
+#include <vector>
+
+class Map;
+
+// Our possible positions as the opponent can deduce them from our orders and from the results
+// of its sonars. It follows the same rules as the opponent tracker, on bitboards (see tracking.hpp).
+class Exposure_tracker
+{
+public:
+    void init(const Map& map);
+
+    void update_with_move(const Map& map, Direction dir);
+    void update_with_silence(const Map& map);
+    void update_with_surface(const Map& map, int sector);
+    void update_with_torpedo(const Map& map, const Position& target);
+    void update_with_sonar(const Map& map, int sector, bool found);
+
+    const Bitboard& possible_positions() const { return positions_; }
+    std::size_t number_of_possible_positions() const { return count_; }
+
+private:
+    // A set which would leave no position means that the opponent cannot follow its own rules:
+    // the previous one is kept.
+    void set_positions_(const Bitboard& positions);
+
+    Bitboard positions_;
+    std::size_t count_ = 0;
+    std::vector<Direction> path_;
+};
@@ -1,20 +1,41 @@
 #include "game.hpp"
+#include "tracking.hpp"
 #include "random.hpp"
 #include "log.hpp"
+#include "memory.hpp"
 #include <algorithm>
-#include <map>
 #include <chrono>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
 
 void Game::init()
 {
     istrm_ >> game_info_ >> avatar_;
     istrm_.ignore();
     map_.resize(game_info_.map_width, game_info_.map_height);
+    // Bitboards are stored inline: a larger map would overrun them.
+    if (map_.padded_size() > Bitboard::max_size)
+        throw std::length_error("map of " + std::to_string(game_info_.map_width) + "x" + std::to_string(game_info_.map_height)
+                                + " too large for the bitboards");
     map_.fill_from_stream(istrm_);
     map_.set_sector_size(default_sector_width(), default_sector_height());
+    map_.select_dimensions();
+    if (!map_.has_standard_dimensions())
+        info() << "Non standard map dimensions: runtime layout selected." << std::endl;
 
     opponent_.id = avatar_.id == 0 ? 1 : 0;
     opponent_.init();
+    avatar_.exposure().init(map_);
+    danger_map_.init(map_);
+    torpedo_targeting_.init(map_);
+    path_planner_.init(map_);
+    rollout_engine_.init(map_);
+    rollout_engine_.set_number_of_threads(number_of_rollout_threads());
+    expectimax_search_.init(map_);
+    endgame_solver_.init(map_);
 }
 
 void Game::print_start_info() const
@@ -25,31 +46,39 @@ void Game::print_start_info() const
 
 Position Game::choose_start_position()
 {
-    std::map<std::size_t, std::vector<Position>, std::greater<std::size_t>> mpos;
-    for (int j = 0; j < map_.height(); ++j)
-        for (int i = 0; i < map_.width(); ++i)
+    // Among the squares of the largest region, the one with the fewest ocean neighbours (dead ends
+    // first); ties at random.
+    map_.update_regions(avatar_.id);
+    Turn_vector<int> indices(turn_resource());
+    int largest_region = -1;
+    map_.ocean_cells().for_each([&](int index)
+    {
+        int region = map_.region_of(index);
+        if (largest_region < 0 || map_.region_size(region) > map_.region_size(largest_region))
         {
-            Position pos(i,j);
-            if (map_.get(pos).is_ocean())
-            {
-                std::size_t zone_size = map_.number_of_reachable_squares(pos, avatar_.id);
-                mpos[zone_size].push_back(pos);
-            }
+            largest_region = region;
+            indices.clear();
         }
-    auto& vpos = mpos.begin()->second;
-    std::shuffle(vpos.begin(), vpos.end(), priv::rand_int_engine());
-    auto iter = std::min_element(vpos.begin(), vpos.end(),
-                                 [&](const Position& lhs, const Position& rhs)
+        if (region == largest_region)
+            indices.push_back(index);
+    });
+    std::shuffle(indices.begin(), indices.end(), priv::rand_int_engine());
+    auto number_of_ocean_neighbours = [&](int index)
+    {
+        const auto& offsets = map_.neighbour_offsets();
+        return std::count_if(offsets.begin(), offsets.end(), [&](int offset) { return map_[index + offset].is_ocean(); });
+    };
+    auto iter = std::min_element(indices.begin(), indices.end(), [&](int lhs, int rhs)
     {
-            return map_.accessibility(lhs, avatar_.id) < map_.accessibility(rhs, avatar_.id);
+        return number_of_ocean_neighbours(lhs) < number_of_ocean_neighbours(rhs);
     });
-    return *iter;
+    return map_.position(*iter);
 }
 
 void Game::play_start_actions()
 {
     Position start_position = choose_start_position();
-    map_.get(start_position).set_visited(avatar_.id);
+    map_.visit(map_.index(start_position), avatar_.id);
     ostrm_ << start_position << std::endl;
     print_start_info();
 }
@@ -63,35 +92,65 @@ void Game::update_data(const Turn_info& turn_info)
     opponent_.save_status();
     // Update simple data
     //-- Avatar
-    avatar_.position() = Position(turn_info.x, turn_info.y);
-    map_.get(avatar_.position()).set_visited(avatar_.id);
-    avatar_.hp() = turn_info.myLife;
+    Position previous_position = avatar_.position();
+    bool previous_position_is_known = avatar_.position_is_known();
+    avatar_.set_position(Position(turn_info.x, turn_info.y));
+    Offset step = avatar_.position() - previous_position;
+    // A SILENCE of several squares visits every square of its line.
+    if (previous_position_is_known && (step.x == 0) != (step.y == 0))
+    {
+        Offset unit((step.x > 0) - (step.x < 0), (step.y > 0) - (step.y < 0));
+        for (Position pos = previous_position + unit; pos != avatar_.position(); pos += unit)
+            map_.visit(map_.index(pos), avatar_.id);
+    }
+    map_.visit(map_.index(avatar_.position()), avatar_.id);
+    if (map_.regions_actor_id() == avatar_.id && std::abs(step.x) + std::abs(step.y) == 1)
+        map_.update_regions_after_visit(map_.index(avatar_.position()));
+    else if (map_.regions_actor_id() != avatar_.id || step != Offset(0,0))
+        map_.update_regions(avatar_.id);
+    avatar_.set_hp(turn_info.myLife);
     avatar_.torpedo().set_cooldown(turn_info.torpedoCooldown);
     avatar_.sonar().set_cooldown(turn_info.sonarCooldown);
     avatar_.silence().set_cooldown(turn_info.silenceCooldown);
     avatar_.mine().set_cooldown(turn_info.mineCooldown);
     avatar_.sonar().set_cooldown(turn_info.sonarCooldown);
     //-- Opponent
-    opponent_.status.hp = turn_info.oppLife;
+    opponent_.set_hp(turn_info.oppLife);
     // Update complex data
     avatar_.sonar().update_info(turn_info.sonarResult);
-    avatar_.torpedo().update_info();
+    // Our blasts of last turn were made with the path orders treated so far: their loss of hit points
+    // is put down to them and to their own orders since.
+    int blast_path_index = opponent_.path_length();
     opponent_.update_data_with_orders(turn_info.opponentOrders);
+    opponent_.update_data_with_hp_loss(avatar_.torpedo().targeted_position(), avatar_.mine().triggered_position(),
+                                       opponent_.previous_status().hp - opponent_.hp(), blast_path_index);
+    avatar_.torpedo().reset_targeted_position();
+    avatar_.mine().reset_triggered_position();
     opponent_.update_position();
+    danger_map_.update(map_, opponent_.possible_positions(), opponent_.probable_mine_cells());
+    if (opponent_.sonar_sector > 0)
+    {
+        int avatar_sector = map_.sector_of(map_.index(avatar_.position()));
+        avatar_.exposure().update_with_sonar(map_, opponent_.sonar_sector, avatar_sector == opponent_.sonar_sector);
+    }
     // Opponent status
     if (opponent_.sector_is_known())
         info() << "Opponent's sector: " << opponent_.sector << std::endl;
     if (opponent_.position_is_known())
         info() << "Opponent's pos: " << opponent_.position() << std::endl;
-//    info() << "Opponent's path: " << opponent_.relative_path.size() << std::endl;
+    info() << "Our possible positions for the opponent: " << avatar_.exposure().number_of_possible_positions() << std::endl;
 }
 
 Direction Game::move_direction()
 {
     trace();
+    route_crosses_mines_ = false;
     Direction dir = Bad;
     if (opponent_.position_is_known())
         dir = move_to_opponent_direction();
+    // Chasing into an articulation point would cut the squares left to us in two.
+    if (dir_is_valid(dir) && map_.is_articulation_point(map_.index(avatar_.position().neighbour(dir))))
+        dir = Bad;
     if (dir == Bad)
         dir = exploration_move_direction();
 
@@ -101,44 +160,81 @@ Direction Game::move_direction()
 Direction Game::exploration_move_direction()
 {
     trace();
-    Position pos = avatar_.position();
-    std::map<unsigned, std::vector<Direction>, std::greater<unsigned>> mdirs;
+    Direction dir = path_planner_.next_direction(map_, avatar_.id, avatar_.position(), turn_start_time_ + path_planning_budget(),
+                                                 danger_map_.dangers());
+    debug() << "planned walk: " << path_planner_.plan_length() << " squares, "
+            << path_planner_.number_of_searched_nodes() << " nodes searched" << std::endl;
+    route_crosses_mines_ = path_planner_.plan_cells(mine_lookahead()).intersects(danger_map_.mine_blast_cells());
+    return dir;
+}
+
+Direction Game::move_to_opponent_direction()
+{
+    return map_.dir_to(avatar_.id, avatar_.position(), opponent_.position(), danger_map_.dangers());
+}
+
+bool Game::sonar_is_worth_firing() const
+{
+    double gain = opponent_.best_sonar_gain();
+    return gain > 0 && gain >= min_sonar_gain_ratio() * opponent_.number_of_possible_positions();
+}
+
+bool Game::sonar_is_worth_charging() const
+{
+    return opponent_.best_sonar_gain() >= min_sonar_gain();
+}
+
+Direction Game::mine_drop_direction() const
+{
+    const Mine& mine = avatar_.mine();
+    if (!mine.is_ready())
+        return Bad;
+    Bitboard covered_cells = mine.cells();
+    spread_blast(map_, covered_cells);
+    int index = map_.index(avatar_.position());
+    Direction best_dir = Bad;
+    std::size_t best_coverage = min_new_mine_coverage() - 1;
     for (unsigned i = 0; i < number_of_directions(); ++i)
     {
         Direction dir = Direction(i);
-        Position npos = pos.neighbour(dir);
-        if (map_.contains(npos))
+        int nindex = index + map_.neighbour_offset(dir);
+        if (!map_[nindex].is_ocean() || mine.cells().test(nindex))
+            continue;
+        Bitboard blast_cells(map_.padded_size());
+        blast_cells.set(nindex);
+        spread_blast(map_, blast_cells);
+        blast_cells &= map_.ocean_cells();
+        blast_cells.subtract(covered_cells);
+        std::size_t coverage = blast_cells.count();
+        if (coverage > best_coverage)
         {
-            unsigned zone_size = map_.number_of_reachable_squares(npos, avatar_.id);
-            if (zone_size > 0)
-                mdirs[zone_size].push_back(dir);
+            best_dir = dir;
+            best_coverage = coverage;
         }
     }
-    if (mdirs.size() > 0)
-    {
-        const auto& dirs = mdirs.begin()->second;
-//            return dirs.front();
-        auto iter = std::min_element(dirs.begin(), dirs.end(),
-                         [&](Direction ldir, Direction rdir)
-                         {
-                             return map_.accessibility(pos.neighbour(ldir), avatar_.id)
-                                     < map_.accessibility(pos.neighbour(rdir), avatar_.id);
-                         });
-        return *iter;
-    }
-    return Bad;
+    return best_dir;
 }
 
-Direction Game::move_to_opponent_direction()
+Torpedo_target Game::best_mine_to_trigger() const
 {
-    return map_.dir_to(avatar_.id, avatar_.position(), opponent_.position());
+    Torpedo_target best;
+    Bitboard opponent_positions = opponent_.possible_positions();
+    avatar_.mine().cells().for_each([&](int index)
+    {
+        Torpedo_target candidate = torpedo_targeting_.evaluate(map_, map_.position(index), opponent_, opponent_positions, avatar_.position());
+        if (candidate.self_damage > 0)
+            return;
+        if (best.total_weight == 0 || candidate.score() > best.score())
+            best = candidate;
+    });
+    return best;
 }
 
 void Game::do_actions()
 {
     trace();
     do_main_actions();
-    debug() << "Marks:\n" << opponent_.mark_map() << std::endl;
+    debug() << "Marks:\n" << std::as_const(opponent_).mark_map() << std::endl;
     std::size_t nb_pos = opponent_.number_of_possible_positions();
     ostrm_ << " | MSG F#" << turn_number_ << ", %" << nb_pos << " ("<< opponent_.position() << ")";
     ostrm_ << std::endl;
@@ -147,77 +243,195 @@ void Game::do_actions()
 void Game::do_main_actions()
 {
     trace();
-    debug() << __LINE__ << std::endl;
-    if (avatar_.sonar().is_ready() && (opponent_.silence_used /*|| opponent_.number_of_possible_positions() >= 50*/))
+    if (avatar_.sonar().is_ready() && sonar_is_worth_firing())
     {
-        int sector = opponent_.most_marked_sector();
+        int sector = opponent_.best_sonar_sector();
+        debug() << "sonar gain: " << opponent_.best_sonar_gain() << std::endl;
         avatar_.sonar().set_request(sector);
         ostrm_ << "SONAR " << sector << " | ";
     }
-    debug() << "before torpedo" << std::endl;
-    if (avatar_.torpedo().is_ready())
+    Torpedo_target mine_target = best_mine_to_trigger();
+    if (mine_target.is_worth_firing())
     {
-        debug() << "hitable_squares_by_torpedo" << std::endl;
-        std::vector<Position> h_squares = avatar_.hitable_squares_by_torpedo();
-        debug() << "sensible_squares" << std::endl;
-        std::vector<Position> s_squares = opponent_.sensible_squares();
-        if (s_squares.empty())
-        {
-            Position center_pos = opponent_.center_of_possible_positions();
-            if (map_.contains(center_pos))
-                s_squares.push_back(center_pos);
-        }
-        std::sort(h_squares.begin(), h_squares.end());
-        std::sort(s_squares.begin(), s_squares.end());
-        std::vector<Position> target_squares;
-        debug() << "before set_intersections" << std::endl;
-        std::set_intersection(s_squares.begin(), s_squares.end(), h_squares.begin(), h_squares.end(), std::back_inserter(target_squares));
-        if (!target_squares.empty())
-        {
-            Position targeted_pos = target_squares.front();
-            if (opponent_.position_is_known()
-                && std::find(target_squares.begin(), target_squares.end(), opponent_.position()) != target_squares.end())
-                targeted_pos = opponent_.position();
-            avatar_.torpedo().fire_to(targeted_pos);
-            debug() << "TORPEDO " << targeted_pos << " | ";
-            ostrm_ << "TORPEDO " << targeted_pos << " | ";
-        }
+        debug() << "mine triggered: " << mine_target.position << ", expected damage: " << mine_target.expected_damage() << std::endl;
+        avatar_.mine().trigger(mine_target.position);
+        ostrm_ << "TRIGGER " << mine_target.position << " | ";
     }
-
-    debug() << __LINE__ << std::endl;
-    Direction move_dir = move_direction();
-    if (avatar_.silence().is_ready() && ( avatar_.has_lost_life() || ( avatar_.torpedo().is_ready() ) ))
+    Direction mine_dir = mine_drop_direction();
+    if (dir_is_valid(mine_dir))
+    {
+        avatar_.mine().drop(map_.index(avatar_.position().neighbour(mine_dir)));
+        ostrm_ << "MINE " << dir_to_string(mine_dir) << " | ";
+    }
+    Rollout_action action;
+    Endgame_solver::Result endgame = solve_endgame();
+    if (endgame.is_win)
+        action = endgame.action;
+    else
     {
-        debug() << __LINE__ << std::endl;
-        unsigned distance = randint<unsigned>(0, 1);
-        if (!dir_is_valid(move_dir))
+        Torpedo_target target;
+        if (avatar_.torpedo().is_ready())
         {
-            move_dir = North;
-            distance = 0;
+            Turn_vector<Position> r_squares = map_.reachable_squares(avatar_.position(), Torpedo::max_radius());
+            target = torpedo_targeting_.best_target(map_, r_squares, opponent_, avatar_.position(), avatar_.hp());
+            debug() << "best torpedo target: " << target.position << ", expected damage: " << target.expected_damage()
+                    << ", self damage: " << target.self_damage << std::endl;
         }
-        ostrm_ << silence_action(move_dir, distance);
+
+        Direction move_dir = move_direction();
+        action = choose_action(candidate_actions(target, move_dir));
+    }
+    auto fire_torpedo = [&]()
+    {
+        Position targeted_pos = action.torpedo_target;
+        avatar_.torpedo().fire_to(targeted_pos);
+        avatar_.exposure().update_with_torpedo(map_, targeted_pos);
+        debug() << "TORPEDO " << targeted_pos << " | ";
+        ostrm_ << "TORPEDO " << targeted_pos;
+    };
+    if (action.fires_torpedo() && !action.fires_after_move)
+    {
+        fire_torpedo();
+        ostrm_ << " | ";
     }
-    else if (dir_is_valid(move_dir))
+    if (action.is_silence())
     {
-        debug() << __LINE__ << std::endl;
-        info() << "ACTION: move_dir: " << dir_to_string(move_dir) << std::endl;
-        ostrm_ << move_action(move_dir) << " " << load_submarine_tool();
+        ostrm_ << silence_action(action.dir, action.silence_distance);
+        avatar_.exposure().update_with_silence(map_);
+    }
+    else if (!action.surface)
+    {
+        info() << "ACTION: move_dir: " << dir_to_string(action.dir) << std::endl;
+        ostrm_ << move_action(action.dir) << " " << (action.charge.empty() ? load_submarine_tool() : action.charge);
+        avatar_.exposure().update_with_move(map_, action.dir);
     }
     else
     {
-        debug() << __LINE__ << std::endl;
         info() << "ACTION: SURFACE" << std::endl;
         ostrm_ << "SURFACE";
         map_.clear_visit(avatar_.id);
+        avatar_.exposure().update_with_surface(map_, map_.sector_of(map_.index(avatar_.position())));
+    }
+    if (action.fires_torpedo() && action.fires_after_move)
+    {
+        ostrm_ << " | ";
+        fire_torpedo();
     }
 }
 
+Turn_vector<Rollout_action> Game::candidate_actions(const Torpedo_target& target, Direction move_dir) const
+{
+    Turn_vector<Rollout_action> movements(turn_resource());
+    if (dir_is_valid(move_dir))
+    {
+        movements.push_back(Rollout_action{ Position(-1,-1), move_dir, -1, false, {} });
+        if (avatar_.torpedo().is_available() && !avatar_.torpedo().is_ready()
+            && avatar_.silence().is_available() && !avatar_.silence().is_ready())
+        {
+            movements.back().charge = "TORPEDO";
+            movements.push_back(movements.back());
+            movements.back().charge = "SILENCE";
+        }
+        bool is_exposed = avatar_.exposure().number_of_possible_positions() <= 4 || route_crosses_mines_;
+        if (avatar_.silence().is_ready() && ( avatar_.has_lost_life() || ( avatar_.torpedo().is_ready() ) || is_exposed ))
+        {
+            movements.push_back(Rollout_action{ Position(-1,-1), move_dir, 1, false, {} });
+            movements.push_back(Rollout_action{ Position(-1,-1), move_dir, 0, false, {} });
+        }
+    }
+    else
+    {
+        movements.push_back(Rollout_action{ Position(-1,-1), Undefined, -1, true, {} });
+        // A SILENCE of length 0 puts the SURFACE off by a turn.
+        if (avatar_.silence().is_ready())
+            movements.push_back(Rollout_action{ Position(-1,-1), North, 0, false, {} });
+    }
+
+    Turn_vector<Rollout_action> actions(turn_resource());
+    for (const Rollout_action& movement : movements)
+    {
+        actions.push_back(movement);
+        if (target.is_worth_firing())
+        {
+            actions.push_back(movement);
+            actions.back().torpedo_target = target.position;
+        }
+    }
+    return actions;
+}
+
+Rollout_action Game::choose_action(const Turn_vector<Rollout_action>& actions)
+{
+    if (actions.size() == 1)
+        return actions.front();
+    if (uses_expectimax_search())
+    {
+        Expectimax_search::Result result = expectimax_search_.search(map_, rollout_state(), opponent_, actions,
+                                                                     turn_start_time_ + action_search_deadline());
+        debug() << "expectimax: depth " << result.depth << ", " << expectimax_search_.number_of_nodes() << " nodes, best action: "
+                << (result.action.fires_torpedo() ? "TORPEDO, " : "")
+                << (result.action.surface ? "SURFACE" : result.action.is_silence() ? "SILENCE" : "MOVE ") << result.action.charge
+                << ", value: " << result.value << std::endl;
+        return result.action;
+    }
+    Turn_vector<Rollout_engine::Action_stats> stats = rollout_engine_.evaluate(map_, rollout_state(), opponent_, actions,
+                                                                               turn_start_time_ + action_search_deadline());
+    auto best = std::max_element(stats.begin(), stats.end(), [](const auto& lhs, const auto& rhs)
+    {
+        return lhs.mean_score() < rhs.mean_score();
+    });
+    if (best == stats.end())
+        return actions.front();
+    debug() << rollout_engine_.number_of_playouts() << " playouts, best action: "
+            << (best->action.fires_torpedo() ? "TORPEDO, " : "")
+            << (best->action.surface ? "SURFACE" : best->action.is_silence() ? "SILENCE" : "MOVE")
+            << ", score: " << best->mean_score() << std::endl;
+    return best->action;
+}
+
+Endgame_solver::Result Game::solve_endgame()
+{
+    if (opponent_.hp() > max_endgame_opponent_hp() || opponent_.number_of_possible_positions() > Endgame_solver::max_number_of_candidates)
+        return Endgame_solver::Result();
+    int their_mine_cooldown = std::max(Mine::total_cooldown() - opponent_.number_of_moves_since(Observation::Mine_drop), 0);
+    Endgame_solver::Result res = endgame_solver_.solve(map_, rollout_state(), opponent_.candidate_indices(),
+                                                       opponent_.possible_mine_cells(), their_mine_cooldown,
+                                                       turn_start_time_ + endgame_solver_budget());
+    debug() << "endgame solver: " << endgame_solver_.number_of_nodes() << " nodes, "
+            << (res.is_win ? "win in " + std::to_string(res.depth) : std::string("no win proven")) << std::endl;
+    return res;
+}
+
+Rollout_state Game::rollout_state() const
+{
+    auto cooldown = [](const Tool& tool) { return tool.is_available() ? static_cast<int>(tool.cooldown()) : std::numeric_limits<int>::max(); };
+    Rollout_state state;
+    state.us.visited = Bitboard(map_.padded_size());
+    map_.ocean_cells().for_each([&](int index)
+    {
+        if (map_[index].is_visited(avatar_.id))
+            state.us.visited.set(index);
+    });
+    state.us.visited_key = map_.visit_key(avatar_.id);
+    state.us.index = map_.index(avatar_.position());
+    state.us.hp = avatar_.hp();
+    state.us.torpedo_cooldown = cooldown(avatar_.torpedo());
+    state.us.silence_cooldown = cooldown(avatar_.silence());
+    state.us.exposure = static_cast<int>(avatar_.exposure().number_of_possible_positions());
+    state.them.visited = Bitboard(map_.padded_size());
+    state.them.hp = opponent_.hp();
+    // Lower bounds: as if every MOVE since the last use of a tool had charged it.
+    state.them.torpedo_cooldown = std::max(Torpedo::total_cooldown() - opponent_.number_of_moves_since(Observation::Torpedo_launch), 0);
+    state.them.silence_cooldown = std::max(Silence::total_cooldown() - opponent_.number_of_moves_since(Observation::Silence), 0);
+    state.them.exposure = static_cast<int>(opponent_.number_of_possible_positions());
+    return state;
+}
+
 std::string_view Game::load_submarine_tool()
 {
     if (avatar_.torpedo().is_available() && !avatar_.torpedo().is_ready())
         return "TORPEDO";
-    else if (avatar_.sonar().is_available() && !avatar_.sonar().is_ready()
-             && ( opponent_.number_of_possible_positions() >= 50 || avatar_.silence().is_available()))
+    else if (avatar_.sonar().is_available() && !avatar_.sonar().is_ready() && sonar_is_worth_charging())
         return "SONAR";
     else if (avatar_.silence().is_available() && !avatar_.silence().is_ready())
         return "SILENCE";
@@ -238,18 +452,24 @@ std::string Game::move_action(Direction dir)
 
 void Game::play_turn()
 {
-    Turn_info turn_info;
-    istrm_ >> turn_info;
-    auto start_time = std::chrono::steady_clock::now();
+    turn_arena().reset();
+    std::size_t allocation_count = heap_allocation_count();
+
+    istrm_ >> turn_info_;
+    turn_start_time_ = std::chrono::steady_clock::now();
 
     info() << "---------------------------------------------" << std::endl;
     info() << "TURN NUMBER: " << turn_number_ << std::endl << std::flush;
 
-    update_data(turn_info);
+    update_data(turn_info_);
     do_actions();
 
     ++turn_number_;
     auto end_time = std::chrono::steady_clock::now();
-    std::chrono::duration<double, std::milli> turn_duration = end_time - start_time;
+    std::chrono::duration<double, std::milli> turn_duration = end_time - turn_start_time_;
     info() << "Turn Duration: " << turn_duration.count() << "ms" << std::endl;
+    std::size_t turn_allocations = heap_allocation_count() - allocation_count;
+    info() << "Turn Heap Allocations: " << turn_allocations << std::endl;
+    if (turn_number_ > warm_up_turns() && turn_allocations > 0)
+        error() << "heap allocations after the warm-up: " << turn_allocations << std::endl;
 }
@@ -3,6 +3,12 @@
 #include "opponent.hpp"
 #include "avatar.hpp"
 #include "map.hpp"
+#include "danger_map.hpp"
+#include "torpedo_targeting.hpp"
+#include "path_planner.hpp"
+#include "rollout.hpp"
+#include "expectimax.hpp"
+#include "endgame_solver.hpp"
 #include "turn_info.hpp"
 #include "game_info.hpp"
 #include "grid.hpp"
@@ -12,8 +18,31 @@
 class Game
 {
 public:
-    static int default_sector_width() { return 5; }
-    static int default_sector_height() { return 5; }
+    static constexpr int default_sector_width() { return Standard_dimensions::sector_width(); }
+    static constexpr int default_sector_height() { return Standard_dimensions::sector_height(); }
+    // A sonar is fired when it rules out at least this fraction of the possible positions on average,
+    // and charged when the best one would currently rule out at least min_sonar_gain() of them.
+    static constexpr double min_sonar_gain_ratio() { return 0.25; }
+    static constexpr double min_sonar_gain() { return 4.; }
+    // Time given to the path planner each turn, counted from the end of the turn input.
+    static constexpr std::chrono::milliseconds path_planning_budget() { return std::chrono::milliseconds(15); }
+    // Our action is chosen by the expectimax search if true, by playouts otherwise.
+    static constexpr bool uses_expectimax_search() { return true; }
+    // End of the search of our action, counted from the end of the turn input.
+    static constexpr std::chrono::milliseconds action_search_deadline() { return std::chrono::milliseconds(25); }
+    static constexpr int number_of_rollout_threads() { return 1; }
+    // The endgame solver runs when the opponent has at most this many hit points and is located up
+    // to Endgame_solver::max_number_of_candidates, until this time from the end of the turn input.
+    static constexpr int max_endgame_opponent_hp() { return 2; }
+    static constexpr std::chrono::milliseconds endgame_solver_budget() { return std::chrono::milliseconds(10); }
+    // A mine is dropped on the neighbour square whose blast covers at least this many ocean squares
+    // out of the blasts of our other mines.
+    static constexpr std::size_t min_new_mine_coverage() { return 6; }
+    // A route crossing the blast of one of their probable mines within this many steps calls for
+    // a SILENCE, as when we are exposed.
+    static constexpr std::size_t mine_lookahead() { return 4; }
+    // Turns after which the heap is no longer used: every buffer is then sized (see memory.hpp).
+    static constexpr int warm_up_turns() { return 2; }
 
     Game(std::istream& istream, std::ostream& ostream)
          : avatar_(*this), opponent_(*this),
@@ -37,11 +66,28 @@ public:
     Direction move_direction();
     Direction exploration_move_direction();
     Direction move_to_opponent_direction();
+    bool sonar_is_worth_firing() const;
+    bool sonar_is_worth_charging() const;
+    // Bad if the mine is not ready or no neighbour square covers enough new squares.
+    Direction mine_drop_direction() const;
+    // Our mine whose blast is the best for the possible positions of the opponent, weighed as a
+    // torpedo target (see Torpedo_target), all of them evaluated in one pass over our mines.
+    Torpedo_target best_mine_to_trigger() const;
 
     void do_actions();
 
     void do_main_actions();
 
+    // Our candidate actions: the MOVE in move_dir (or the SURFACE), charging the torpedo or the silence
+    // when both are charging, and a SILENCE of length 1 or 0 instead when the silence rules call for
+    // one, each with or without a torpedo at target when it is worth firing.
+    Turn_vector<Rollout_action> candidate_actions(const Torpedo_target& target, Direction move_dir) const;
+    // The best action for the expectimax search, or the one with the best mean score over playouts.
+    Rollout_action choose_action(const Turn_vector<Rollout_action>& actions);
+    // A forced win, if the endgame solver finds one.
+    Endgame_solver::Result solve_endgame();
+    Rollout_state rollout_state() const;
+
     std::string_view load_submarine_tool();
 
     // actions formatting:
@@ -59,14 +105,24 @@ public:
     const Avatar& avatar() const { return avatar_; }
     const Opponent& opponent() const { return opponent_; }
     Opponent& opponent() { return opponent_; }
+    const Danger_map& danger_map() const { return danger_map_; }
     int turn_number() const { return turn_number_; }
 
 private:
     int turn_number_ = 0;
     Game_info game_info_;
+    Turn_info turn_info_;
     Map map_;
     Avatar avatar_;
     Opponent opponent_;
+    Danger_map danger_map_;
+    Torpedo_targeting torpedo_targeting_;
+    Path_planner path_planner_;
+    Rollout_engine rollout_engine_;
+    Expectimax_search expectimax_search_;
+    Endgame_solver endgame_solver_;
+    std::chrono::steady_clock::time_point turn_start_time_;
+    bool route_crosses_mines_ = false; // set by exploration_move_direction()
 
     std::istream& istrm_;
     std::ostream& ostrm_;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "vec2.hpp"
+#include "memory.hpp"
 #include <vector>
 #include <ostream>
 #include <iomanip>
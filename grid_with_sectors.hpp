@@ -1,16 +1,17 @@
 #pragma once
 
 #include "grid.hpp"
+#include "padded_grid.hpp"
 #include "log.hpp"
 
 using Sector_position = Vec2;
 
-template <class Type>
-class Grid_with_sectors : public Grid<Type>
+template <class Type, class Base_grid = Grid<Type>>
+class Grid_with_sectors : public Base_grid
 {
 public:
     Grid_with_sectors(int width = 0, int height = 0)
-        : Grid<Type>(width, height)
+        : Base_grid(width, height)
     {}
 
     inline int sector_width() const { return sector_width_; }
@@ -32,7 +33,7 @@ public:
         {
             int sx = pos.x / sector_width();
             int sy = pos.y / sector_height();
-            return sy * number_of_sectors_on_y() + sx + 1;
+            return sy * number_of_sectors_on_x() + sx + 1;
         }
         error() << "invalid position: " << pos << std::endl;
         return -1;
@@ -62,40 +63,6 @@ public:
         return Position(spos.x * sector_width_, spos.y * sector_height_);
     }
 
-    void fill_sector_if(int sector, const Type& value, const Type& value_to_replace)
-    {
-        Position origin = sector_origin(sector);
-        for (int j = 0; j < sector_height_; ++j)
-        {
-            for (int i = 0; i < sector_width_; ++i)
-            {
-                Position pos = Position(i,j) + origin;
-                Type& datum = this->get(pos);
-                if (datum == value_to_replace)
-                    datum = value;
-            }
-        }
-    }
-
-    std::size_t count_in_sector(int sector, const Type& value) const
-    {
-        std::size_t res = 0;
-
-        Position origin = sector_origin(sector);
-        for (int j = 0; j < sector_height_; ++j)
-        {
-            for (int i = 0; i < sector_width_; ++i)
-            {
-                Position pos = Position(i,j) + origin;
-                const Type& datum = this->get(pos);
-                if (datum == value)
-                    ++res;
-            }
-        }
-
-        return res;
-    }
-
 protected:
     int sector_width_ = -1;
     int sector_height_ = -1;
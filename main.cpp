@@ -26,10 +26,14 @@
 #include "map.hpp"
 #include "square.hpp"
 #include "grid_with_sectors.hpp"
+#include "stencil.hpp"
 #include "grid.hpp"
+#include "padded_grid.hpp"
 #include "vec2.hpp"
+#include "dimensions.hpp"
 #include "direction.hpp"
 #include "log.hpp"
+#include "memory.hpp"
 #include "random.hpp"
 
 int main()
@@ -1,181 +1,192 @@
 #include "map.hpp"
-#include <queue>
+#include "zobrist.hpp"
+#include <algorithm>
 #include <cassert>
 
 Map::Map(int width, int height)
-    : Grid_with_sectors<Square>(width, height)
+    : Grid_with_sectors<Square, Padded_grid<Square>>(width, height)
 {}
 
+void Map::select_dimensions()
+{
+    dimensions_ = Dynamic_dimensions(width(), height(), sector_width(), sector_height());
+    has_standard_dimensions_ = dimensions_.matches<Standard_dimensions>();
+
+    sector_of_index_.assign(padded_size(), 0);
+    sector_cells_.assign(dimensions_.number_of_sectors(), Bitboard(padded_size()));
+    ocean_cells_ = Bitboard(padded_size());
+    cell_keys_.resize(padded_size());
+    for (std::size_t index = 0; index < cell_keys_.size(); ++index)
+        cell_keys_[index] = zobrist::key(zobrist::Cell, index);
+    visit_keys_.fill(0);
+    for (int j = 0; j < height(); ++j)
+    {
+        for (int i = 0; i < width(); ++i)
+        {
+            int index = this->index(i,j);
+            int sector = dimensions_.sector_index(Position(i,j));
+            sector_of_index_[index] = sector;
+            sector_cells_[sector - 1].set(index);
+            if ((*this)[index].is_ocean())
+                ocean_cells_.set(index);
+        }
+    }
+
+    regions_actor_id_ = -1;
+    region_of_index_.assign(padded_size(), -1);
+    region_sizes_.reserve(padded_size());
+    articulation_points_ = Bitboard(padded_size());
+    blocks_.reserve(2 * padded_size());
+    block_cells_.reserve(4 * padded_size());
+    block_of_index_.assign(padded_size(), -1);
+    discovery_.assign(padded_size(), -1);
+    low_.assign(padded_size(), -1);
+    dfs_stack_.reserve(padded_size());
+    vertex_stack_.reserve(padded_size());
+}
+
 void Map::fill_from_stream(std::istream& stream)
 {
     std::string line;
-    for (auto& row : data_)
+    for (int j = 0; j < height_; ++j)
     {
         std::getline(stream, line);
         for (int i = 0; i < width_; ++i)
-            row[i] = Square(line.at(i));
+            get(i,j) = Square(line.at(i));
     }
 }
 
-void Map::clear_visit(int actor_id)
+void Map::visit(int index, int actor_id)
 {
-    for (auto& row : data_)
-        for (auto& square : row)
-            square.unset_visited(actor_id);
+    Square& square = data_[index];
+    if (square.is_visited(actor_id))
+        return;
+    square.set_visited(actor_id);
+    visit_keys_[actor_id] ^= cell_keys_[index];
 }
 
-std::size_t Map::accessibility(const Position& pos, int actor_id) const
+void Map::clear_visit(int actor_id)
 {
-    std::size_t res = 0;
-    const Square& square = get(pos);
-    if (square.is_ocean() && !square.is_visited(actor_id))
-    {
-        for (unsigned dir = 0; dir < number_of_directions(); ++dir)
-        {
-            Position npos = pos.neighbour(Direction(dir));
-            if (contains(npos))
-            {
-                const Square& nsquare = get(npos);
-                if (!nsquare.is_visited(actor_id) && nsquare.is_ocean())
-                    ++res;
-            }
-        }
-    }
-    return res;
+    for (auto& square : data_)
+        square.unset_visited(actor_id);
+    visit_keys_[actor_id] = 0;
+    if (actor_id == regions_actor_id_)
+        regions_actor_id_ = -1;
 }
 
-std::size_t Map::number_of_reachable_squares(const Position& pos, int actor_id)
+Turn_vector<Position> Map::reachable_squares(const Position& pos, std::size_t radius) const
 {
-    std::size_t count = 0;
-
-    Grid<uint8_t> visited(width(), height(), 0);
-    std::queue<Position> posq;
-    auto is_reachable = [&](const Position& sqpos)
+    return with_dimensions([&](const auto& dims)
     {
-        const Square& square = get(sqpos);
-        return square.is_ocean() && !square.is_visited(actor_id);
-    };
-    auto visit = [&](const Position& sqpos)
-    {
-        visited.get(sqpos) = 1;
-        posq.push(sqpos);
-        ++count;
-    };
-
-    if (is_reachable(pos))
-        visit(pos);
+        Turn_vector<Position> positions(turn_resource());
+        positions.reserve(dims.width() * dims.height());
 
-    while (!posq.empty())
-    {
-        Position cpos = posq.front();
-        posq.pop();
-        for (unsigned i = 0; i < number_of_directions(); ++i)
+        Turn_vector<int16_t> visited(dims.padded_size(), -1, turn_resource());
+        Turn_vector<int> indexq(turn_resource());
+        indexq.reserve(dims.width() * dims.height());
+        auto is_reachable = [&](int index, int16_t dist)
         {
-            Direction dir = Direction(i);
-            Position npos = cpos.neighbour(dir);
-            if (contains(npos) && is_reachable(npos) && !visited.get(npos))
-                visit(npos);
-        }
-    }
-
-    return count;
-}
-
-std::vector<Position> Map::reachable_squares(const Position& pos, std::size_t radius) const
-{
-    std::vector<Position> positions;
-
-    Grid<int16_t> visited(width(), height(), -1);
-    std::queue<Position> posq;
-    auto is_reachable = [&](const Position& sqpos, int16_t dist)
-    {
-        const Square& square = get(sqpos);
-        return square.is_ocean() && dist <= static_cast<int>(radius);
-    };
-    auto visit = [&](const Position& sqpos, int16_t dist)
-    {
-        visited.get(sqpos) = dist;
-        posq.push(sqpos);
-        positions.push_back(sqpos);
-    };
+            return data_[index].is_ocean() && dist <= static_cast<int>(radius);
+        };
+        auto visit = [&](int index, int16_t dist)
+        {
+            visited[index] = dist;
+            indexq.push_back(index);
+            positions.push_back(dims.position(index));
+        };
 
-    if (is_reachable(pos, 0))
-        visit(pos, 0);
+        if (dims.contains(pos) && is_reachable(dims.index(pos), 0))
+            visit(dims.index(pos), 0);
 
-    while (!posq.empty())
-    {
-        Position cpos = posq.front();
-        posq.pop();
-        int16_t dist = visited.get(cpos) + 1;
-        for (unsigned i = 0; i < number_of_directions(); ++i)
+        for (std::size_t qindex = 0; qindex < indexq.size(); ++qindex)
         {
-            Direction dir = Direction(i);
-            Position npos = cpos.neighbour(dir);
-            if (contains(npos) && visited.get(npos) < 0 && is_reachable(npos, dist))
-                visit(npos, dist);
+            int cindex = indexq[qindex];
+            int16_t dist = visited[cindex] + 1;
+            for (unsigned i = 0; i < number_of_directions(); ++i)
+            {
+                int nindex = cindex + dims.neighbour_offset(Direction(i));
+                if (visited[nindex] < 0 && is_reachable(nindex, dist))
+                    visit(nindex, dist);
+            }
         }
-    }
 
-    return positions;
+        return positions;
+    });
 }
 
 struct Mark
 {
-    Position previous_position = Position(-1,-1);
+    int previous_index = -1;
     Direction direction = Undefined;
 
-    Mark() : previous_position(-1,-1), direction(Undefined) {}
-    Mark(const Position& ppos, Direction dir) : previous_position(ppos), direction(dir) {}
+    Mark() : previous_index(-1), direction(Undefined) {}
+    Mark(int pindex, Direction dir) : previous_index(pindex), direction(dir) {}
     Direction opposed_direction() const { return ::opposed_direction(direction); }
     bool is_undefined() const { return direction == Undefined; }
 
     friend std::ostream& operator<<(std::ostream& stream, const Mark& mark)
     {
-        return stream << "[" << mark.previous_position << "," << dir_to_string(mark.direction) << "]";
+        return stream << "[" << mark.previous_index << "," << dir_to_string(mark.direction) << "]";
     }
 };
 
-Direction Map::dir_to(int avatar_id, const Position& start, const Position& dest) const
+Direction Map::dir_to(int avatar_id, const Position& start, const Position& dest, const std::vector<int>& step_costs) const
 {
     trace();
     Direction dir = Bad;
+    if (!contains(start) || !contains(dest))
+        return dir;
 
-    Grid<Mark> marks(width(), height());
-    std::queue<Position> posq;
-    auto is_reachable = [&](const Position& sqpos/*, int16_t dist*/)
+    Turn_vector<Mark> marks(padded_size(), Mark(), turn_resource());
+    Turn_vector<int> distances(padded_size(), -1, turn_resource());
+    Turn_vector<int> costs(padded_size(), 0, turn_resource());
+    auto step_cost = [&](int index) { return step_costs.empty() ? 0 : step_costs[index]; };
+    Turn_vector<int> indexq(turn_resource());
+    indexq.reserve(width() * height());
+    auto is_reachable = [&](int index/*, int16_t dist*/)
     {
-        const Square& square = get(sqpos);
+        const Square& square = data_[index];
         return square.is_ocean() && !square.is_visited(avatar_id) /*&& dist <= static_cast<int>(radius)*/;
     };
-    auto visit = [&](const Position& sqpos, const Mark& mark)
+    auto visit = [&](int index, const Mark& mark, int distance, int cost)
     {
-        marks.get(sqpos) = mark;
-        posq.push(sqpos);
+        marks[index] = mark;
+        distances[index] = distance;
+        costs[index] = cost;
+        indexq.push_back(index);
     };
 
-    if (get(start).is_ocean())
-        visit(start, Mark(start, Bad));
+    int start_index = index(start);
+    int dest_index = index(dest);
+    if (data_[start_index].is_ocean())
+        visit(start_index, Mark(start_index, Bad), 0, 0);
 
-    while (!posq.empty() && marks.get(dest).is_undefined())
+    // The queue holds the squares by increasing distance: when a square is expanded, all the
+    // squares one step closer have been, so its cost is final.
+    for (std::size_t qindex = 0; qindex < indexq.size() && (marks[dest_index].is_undefined() || distances[indexq[qindex]] < distances[dest_index]); ++qindex)
     {
-        Position cpos = posq.front();
-        posq.pop();
+        int cindex = indexq[qindex];
         for (unsigned i = 0; i < number_of_directions(); ++i)
         {
             Direction dir = Direction(i);
-            Position npos = cpos.neighbour(dir);
-            Mark mark(cpos, dir);
-            if (contains(npos) && marks.get(npos).is_undefined() && is_reachable(npos))
-                visit(npos, mark);
+            int nindex = cindex + neighbour_offset(dir);
+            int cost = costs[cindex] + step_cost(nindex);
+            if (marks[nindex].is_undefined() && is_reachable(nindex))
+                visit(nindex, Mark(cindex, dir), distances[cindex] + 1, cost);
+            else if (distances[nindex] == distances[cindex] + 1 && cost < costs[nindex])
+            {
+                marks[nindex] = Mark(cindex, dir);
+                costs[nindex] = cost;
+            }
         }
     }
 
 //    debug() << marks << std::endl;
-    const Mark* pmark = &marks.get(dest);
+    const Mark* pmark = &marks[dest_index];
     if (!pmark->is_undefined())
     {
-        while (pmark->previous_position != start)
-            pmark = &marks.get(pmark->previous_position);
+        while (pmark->previous_index != start_index)
+            pmark = &marks[pmark->previous_index];
 //        debug() << "\nmark final: " << *pmark << ", ";
         dir = pmark->direction;
     }
@@ -184,11 +195,209 @@ Direction Map::dir_to(int avatar_id, const Position& start, const Position& dest
 
 std::ostream& operator<<(std::ostream& stream, const Map& map)
 {
-    for (const auto& row : map.data_)
+    for (int j = 0; j < map.height(); ++j)
     {
-        for (const auto& square : row)
-            stream << square.type();
+        for (int i = 0; i < map.width(); ++i)
+            stream << map.get(i,j).type();
         stream << std::endl;
     }
     return stream;
 }
+
+void Map::update_regions(int actor_id)
+{
+    regions_actor_id_ = actor_id;
+    std::fill(region_of_index_.begin(), region_of_index_.end(), -1);
+    std::fill(discovery_.begin(), discovery_.end(), -1);
+    region_sizes_.clear();
+    articulation_points_.clear();
+    blocks_.clear();
+    block_cells_.clear();
+    ocean_cells_.for_each([&](int index)
+    {
+        if (region_of_index_[index] < 0 && is_free_(index))
+        {
+            region_sizes_.push_back(0);
+            decompose_region_(index, static_cast<int>(region_sizes_.size()) - 1);
+        }
+    });
+}
+
+void Map::update_regions_after_visit(int index)
+{
+    assert(regions_actor_id_ >= 0);
+    int region = region_of_index_[index];
+    if (region < 0)
+        return;
+    // The blocks of the decomposed regions are left in place until the next full update.
+    if (block_cells_.size() + 2 * region_sizes_[region] > block_cells_.capacity()
+        || blocks_.size() + region_sizes_[region] > blocks_.capacity())
+    {
+        update_regions(regions_actor_id_);
+        return;
+    }
+
+    ocean_cells_.for_each([&](int cindex)
+    {
+        if (region_of_index_[cindex] == region)
+        {
+            region_of_index_[cindex] = -1;
+            discovery_[cindex] = -1;
+            articulation_points_.reset(cindex);
+        }
+    });
+    for (Block& block : blocks_)
+        if (block.region == region)
+            block.region = -1;
+    region_sizes_[region] = 0;
+
+    bool reuses_region = true;
+    for (int offset : neighbour_offsets())
+    {
+        int nindex = index + offset;
+        if (region_of_index_[nindex] >= 0 || !is_free_(nindex))
+            continue;
+        if (!reuses_region)
+        {
+            region = static_cast<int>(region_sizes_.size());
+            region_sizes_.push_back(0);
+        }
+        decompose_region_(nindex, region);
+        reuses_region = false;
+    }
+}
+
+void Map::decompose_region_(int root, int region)
+{
+    int16_t time = 0;
+    auto discover = [&](int index, int parent)
+    {
+        discovery_[index] = time;
+        low_[index] = time;
+        ++time;
+        region_of_index_[index] = region;
+        ++region_sizes_[region];
+        vertex_stack_.push_back(index);
+        dfs_stack_.push_back(Dfs_frame{ index, parent, 0 });
+    };
+
+    int number_of_root_children = 0;
+    vertex_stack_.clear();
+    dfs_stack_.clear();
+    discover(root, -1);
+    while (!dfs_stack_.empty())
+    {
+        Dfs_frame& frame = dfs_stack_.back();
+        if (frame.next_dir < static_cast<int>(number_of_directions()))
+        {
+            int index = frame.index;
+            int nindex = index + neighbour_offset(Direction(frame.next_dir++));
+            if (!is_free_(nindex))
+                continue;
+            if (discovery_[nindex] < 0)
+            {
+                if (index == root)
+                    ++number_of_root_children;
+                discover(nindex, index);
+            }
+            else
+                low_[index] = std::min(low_[index], discovery_[nindex]);
+            continue;
+        }
+
+        Dfs_frame finished = frame;
+        dfs_stack_.pop_back();
+        if (finished.parent < 0)
+            continue;
+        int parent = finished.parent;
+        low_[parent] = std::min(low_[parent], low_[finished.index]);
+        if (low_[finished.index] >= discovery_[parent])
+        {
+            // parent separates the subtree of finished.index from the rest of the region.
+            if (parent != root)
+                articulation_points_.set(parent);
+            add_block_(region, parent, finished.index);
+        }
+    }
+    if (number_of_root_children >= 2)
+        articulation_points_.set(root);
+    if (number_of_root_children == 0)
+        add_block_(region, -1, root);
+}
+
+// The block is made of the squares stacked since last_index, and of cut_index (-1 for none).
+void Map::add_block_(int region, int cut_index, int last_index)
+{
+    Block block;
+    block.region = region;
+    block.first_cell = static_cast<int>(block_cells_.size());
+    int block_index = static_cast<int>(blocks_.size());
+    for (int index = -1; index != last_index;)
+    {
+        index = vertex_stack_.back();
+        vertex_stack_.pop_back();
+        block_cells_.push_back(index);
+        block_of_index_[index] = static_cast<int16_t>(block_index);
+    }
+    if (cut_index >= 0)
+    {
+        block_cells_.push_back(cut_index);
+        block_of_index_[cut_index] = static_cast<int16_t>(block_index);
+    }
+    block.size = static_cast<int>(block_cells_.size()) - block.first_cell;
+    blocks_.push_back(block);
+}
+
+int Map::walk_bound(int index) const
+{
+    assert(regions_actor_id_ >= 0);
+    // The blocks of each articulation point, sorted by articulation point.
+    Turn_vector<std::pair<int, int>> cut_blocks(turn_resource());
+    for (std::size_t block_index = 0; block_index < blocks_.size(); ++block_index)
+    {
+        const Block& block = blocks_[block_index];
+        if (block.region < 0)
+            continue;
+        for (int i = block.first_cell; i < block.first_cell + block.size; ++i)
+            if (articulation_points_.test(block_cells_[i]))
+                cut_blocks.emplace_back(block_cells_[i], static_cast<int>(block_index));
+    }
+    std::sort(cut_blocks.begin(), cut_blocks.end());
+
+    int res = 0;
+    for (int offset : neighbour_offsets())
+    {
+        int nindex = index + offset;
+        if (!is_free_(nindex))
+            continue;
+        if (!articulation_points_.test(nindex))
+        {
+            res = std::max(res, 1 + block_walk_bound_(block_of_index_[nindex], nindex, cut_blocks));
+            continue;
+        }
+        auto range = std::equal_range(cut_blocks.begin(), cut_blocks.end(), std::make_pair(nindex, 0),
+                                      [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+        for (auto iter = range.first; iter != range.second; ++iter)
+            res = std::max(res, 1 + block_walk_bound_(iter->second, nindex, cut_blocks));
+    }
+    return res;
+}
+
+// Squares of a walk entering block on entry_index, not counting the entry.
+int Map::block_walk_bound_(int block_index, int entry_index, const Turn_vector<std::pair<int, int>>& cut_blocks) const
+{
+    const Block& block = blocks_[block_index];
+    int res = 0;
+    for (int i = block.first_cell; i < block.first_cell + block.size; ++i)
+    {
+        int index = block_cells_[i];
+        if (index == entry_index || !articulation_points_.test(index))
+            continue;
+        auto range = std::equal_range(cut_blocks.begin(), cut_blocks.end(), std::make_pair(index, 0),
+                                      [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+        for (auto iter = range.first; iter != range.second; ++iter)
+            if (iter->second != block_index)
+                res = std::max(res, block_walk_bound_(iter->second, index, cut_blocks));
+    }
+    return block.size - 1 + res;
+}
@@ -2,24 +2,104 @@
 
 #include "square.hpp"
 #include "grid_with_sectors.hpp"
+#include "dimensions.hpp"
+#include "bitboard.hpp"
+#include <array>
 #include <limits>
 
-class Map : public Grid_with_sectors<Square>
+class Map : public Grid_with_sectors<Square, Padded_grid<Square>>
 {
 public:
     Map(int width = 0, int height = 0);
 
+    void select_dimensions();
+    const Dynamic_dimensions& dimensions() const { return dimensions_; }
+    bool has_standard_dimensions() const { return has_standard_dimensions_; }
+
+    // Calls function with the compile-time Standard_dimensions when they apply, else with dimensions().
+    template <class Function>
+    decltype(auto) with_dimensions(Function&& function) const
+    {
+        return visit_dimensions(dimensions_, has_standard_dimensions_, std::forward<Function>(function));
+    }
+
+    // Sector of each cell index (0 on the border), cells of each sector and ocean cells, built by select_dimensions().
+    inline int sector_of(int index) const { return sector_of_index_[index]; }
+    inline const Bitboard& sector_cells(int sector) const { return sector_cells_[sector - 1]; }
+    inline const Bitboard& ocean_cells() const { return ocean_cells_; }
+
     void fill_from_stream(std::istream& stream);
 
+    // Marks the square index visited by actor_id.
+    void visit(int index, int actor_id);
     void clear_visit(int actor_id);
+    // Zobrist key of the squares visited by actor_id, XOR of their cell keys: kept up to date by
+    // visit() and clear_visit() in one operation each.
+    uint64_t visit_key(int actor_id) const { return visit_keys_[actor_id]; }
+    inline uint64_t cell_key(int index) const { return cell_keys_[index]; }
 
-    std::size_t accessibility(const Position& pos, int actor_id) const;
-
-    std::size_t number_of_reachable_squares(const Position& pos, int actor_id);
+    Turn_vector<Position> reachable_squares(const Position& pos, std::size_t radius = std::numeric_limits<std::size_t>::max()) const;
 
-    std::vector<Position> reachable_squares(const Position& pos, std::size_t radius = std::numeric_limits<std::size_t>::max()) const;
+    // First direction of a shortest path from start to dest. Among the shortest paths, the one
+    // with the lowest sum of step_costs (indexed by cell index, empty for none) is followed.
+    Direction dir_to(int avatar_id, const Position& start, const Position& dest, const std::vector<int>& step_costs = {}) const;
 
-    Direction dir_to(int avatar_id, const Position& start, const Position& dest) const;
+    // Regions (connected components) of the free squares, ocean squares not visited by an actor,
+    // with their articulation points and biconnected blocks. update_regions computes them for
+    // actor_id. update_regions_after_visit only decomposes again the region which contained index,
+    // when it is the one square visited by the actor since the last update. clear_visit of the
+    // actor invalidates them: regions_actor_id() is then -1.
+    void update_regions(int actor_id);
+    void update_regions_after_visit(int index);
+    int regions_actor_id() const { return regions_actor_id_; }
+    inline int region_of(int index) const { return region_of_index_[index]; } // -1 if not free
+    inline int region_size(int region) const { return region_sizes_[region]; }
+    // Visiting an articulation point cuts its region in two or more.
+    inline bool is_articulation_point(int index) const { return articulation_points_.test(index); }
+    // Upper bound of the number of squares of a self-avoiding walk over the free squares which
+    // starts on a free neighbour of index. The walk crosses a chain of blocks of the block-cut tree.
+    int walk_bound(int index) const;
 
     friend std::ostream& operator<<(std::ostream& stream, const Map& map);
+
+private:
+    struct Block
+    {
+        int region = -1; // -1 once its region is decomposed again
+        int first_cell = 0; // in block_cells_
+        int size = 0;
+    };
+    struct Dfs_frame
+    {
+        int index;
+        int parent;
+        int next_dir;
+    };
+
+    inline bool is_free_(int index) const { return data_[index].is_ocean() && !data_[index].is_visited(regions_actor_id_); }
+    // Tarjan's algorithm on the free squares reachable from root, labelled region.
+    void decompose_region_(int root, int region);
+    void add_block_(int region, int cut_index, int last_index);
+    int block_walk_bound_(int block, int entry_index, const Turn_vector<std::pair<int, int>>& cut_blocks) const;
+
+    Dynamic_dimensions dimensions_;
+    bool has_standard_dimensions_ = false;
+    std::vector<int8_t> sector_of_index_;
+    std::vector<Bitboard> sector_cells_;
+    Bitboard ocean_cells_;
+    std::vector<uint64_t> cell_keys_;
+    std::array<uint64_t, 64> visit_keys_ = {}; // [actor_id], as the visited mask of Square
+
+    int regions_actor_id_ = -1;
+    std::vector<int16_t> region_of_index_;
+    std::vector<int> region_sizes_;
+    Bitboard articulation_points_;
+    std::vector<Block> blocks_;
+    std::vector<int> block_cells_;
+    std::vector<int16_t> block_of_index_; // the block of a square which is not an articulation point
+    // Depth-first search state, kept from one update to the next to avoid allocations.
+    std::vector<int16_t> discovery_;
+    std::vector<int16_t> low_;
+    std::vector<Dfs_frame> dfs_stack_;
+    std::vector<int> vertex_stack_;
 };
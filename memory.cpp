@@ -0,0 +1,46 @@
+#include "memory.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace priv
+{
+std::atomic<std::size_t>& heap_allocation_counter()
+{
+    static std::atomic<std::size_t> counter(0);
+    return counter;
+}
+}
+
+Turn_arena::Turn_arena()
+    : resource_(buffer_.data(), buffer_.size(), std::pmr::new_delete_resource())
+{}
+
+Turn_arena& turn_arena()
+{
+    static Turn_arena arena;
+    return arena;
+}
+
+std::size_t heap_allocation_count()
+{
+    return priv::heap_allocation_counter().load(std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t size)
+{
+    priv::heap_allocation_counter().fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <memory_resource>
+#include <functional>
+#include <vector>
+#include <map>
+#include <array>
+#include <cstddef>
+
+template <class Type>
+using Turn_vector = std::pmr::vector<Type>;
+
+template <class Key, class Value, class Compare = std::less<Key>>
+using Turn_map = std::pmr::map<Key, Value, Compare>;
+
+// Monotonic arena holding the temporaries of one turn. It is reset at the start of each turn,
+// so nothing allocated from it may be kept from one turn to the next.
+class Turn_arena
+{
+public:
+    inline static constexpr std::size_t buffer_size = std::size_t(1) << 19;
+
+    Turn_arena();
+    Turn_arena(const Turn_arena&) = delete;
+    Turn_arena& operator=(const Turn_arena&) = delete;
+
+    std::pmr::memory_resource* resource() { return &resource_; }
+    void reset() { resource_.release(); }
+
+private:
+    alignas(std::max_align_t) std::array<std::byte, buffer_size> buffer_;
+    std::pmr::monotonic_buffer_resource resource_;
+};
+
+Turn_arena& turn_arena();
+
+inline std::pmr::memory_resource* turn_resource() { return turn_arena().resource(); }
+
+// Number of calls to the global operator new since the start of the program. Game::play_turn()
+// checks that it stays flat once the warm-up turns are over.
+std::size_t heap_allocation_count();
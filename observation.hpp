@@ -0,0 +1,68 @@
+#pragma once
+
+#include "grid.hpp"
+#include "direction.hpp"
+#include <cstdint>
+
+// Something learnt about the opponent: one of its orders or the feedback of one of ours.
+struct Observation
+{
+    enum Type : uint8_t
+    {
+        Move,           // MOVE dir
+        Surface,        // SURFACE sector
+        Silence,        // SILENCE
+        Torpedo_launch, // their TORPEDO at position: they were in torpedo range of it
+        Sonar_result,   // our SONAR on sector: value is 1 if they were found in it, 0 otherwise
+        Hp_loss,        // value: the hit points they lost from our last turn to now, to be put down to our
+                        // blasts at position (TORPEDO) and mine_position (TRIGGER), made at path_index,
+                        // and to their orders since (SURFACE, their own TORPEDO and TRIGGER)
+        Mine_drop,      // their MINE: dropped next to where they were
+        Mine_trigger,   // their TRIGGER at position: one of their mines was there
+    };
+
+    static Observation move(Direction dir) { Observation obs(Move); obs.dir = dir; return obs; }
+    static Observation surface(int sector) { Observation obs(Surface); obs.sector = sector; return obs; }
+    static Observation silence() { return Observation(Silence); }
+    static Observation torpedo_launch(const Position& target) { Observation obs(Torpedo_launch); obs.position = target; return obs; }
+    static Observation mine_drop() { return Observation(Mine_drop); }
+    static Observation mine_trigger(const Position& position) { Observation obs(Mine_trigger); obs.position = position; return obs; }
+    static Observation sonar_result(int sector, bool found, int path_index)
+    {
+        Observation obs(Sonar_result);
+        obs.sector = sector;
+        obs.value = found;
+        obs.path_index = path_index;
+        return obs;
+    }
+    static Observation hp_loss(const Position& torpedo_target, const Position& mine_position, int damage, int path_index)
+    {
+        Observation obs(Hp_loss);
+        obs.position = torpedo_target;
+        obs.mine_position = mine_position;
+        obs.value = damage;
+        obs.path_index = path_index;
+        return obs;
+    }
+
+    // Move, Surface and Silence extend or reset the path: they are applied as soon as they are
+    // known. The others only filter the current possible positions, so they can wait and be
+    // applied together, cheapest first. The mine observations filter nothing: they come last, to
+    // see the positions filtered by the others.
+    bool changes_path() const { return type == Move || type == Surface || type == Silence; }
+    bool is_about_mines() const { return type == Mine_drop || type == Mine_trigger; }
+    int cost() const { return type == Sonar_result ? 0 : type == Hp_loss ? 1 : is_about_mines() ? 3 : 2; }
+
+    Type type;
+    Direction dir = Undefined;
+    int sector = -1;
+    int value = 0;
+    Position position = Position(-1,-1);
+    Position mine_position = Position(-1,-1);
+    // Number of path orders (MOVE, SURFACE, SILENCE) treated before the observation was made.
+    // -1 when it is made now.
+    int path_index = -1;
+
+private:
+    explicit Observation(Type type) : type(type) {}
+};
@@ -1,18 +1,27 @@
 TEMPLATE = app
-CONFIG += console c++17
+CONFIG += console c++17 thread
 CONFIG -= app_bundle
 CONFIG -= qt
 
 SOURCES += \
         avatar.cpp \
+        danger_map.cpp \
         direction.cpp \
+        endgame_solver.cpp \
+        expectimax.cpp \
+        exposure_tracker.cpp \
         game.cpp \
         main.cpp \
         map.cpp \
+        memory.cpp \
         opponent.cpp \
+        path_planner.cpp \
         player.cpp \
         random.cpp \
+        rollout.cpp \
         tool.cpp \
+        torpedo_targeting.cpp \
+        tracking.cpp \
         turn_info.cpp \
         vec2.cpp
 
@@ -21,17 +30,33 @@ DISTFILES += \
 
 HEADERS += \
     avatar.hpp \
+    bitboard.hpp \
+    danger_map.hpp \
+    dimensions.hpp \
     direction.hpp \
+    endgame_solver.hpp \
+    expectimax.hpp \
+    exposure_tracker.hpp \
     game.hpp \
     game_info.hpp \
     grid.hpp \
     grid_with_sectors.hpp \
     log.hpp \
     map.hpp \
+    memory.hpp \
+    observation.hpp \
     opponent.hpp \
+    padded_grid.hpp \
+    path_planner.hpp \
     player.hpp \
     random.hpp \
+    rollout.hpp \
+    simd.hpp \
     square.hpp \
+    stencil.hpp \
     tool.hpp \
+    torpedo_targeting.hpp \
+    tracking.hpp \
     turn_info.hpp \
-    vec2.hpp
+    vec2.hpp \
+    zobrist.hpp
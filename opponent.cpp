@@ -1,50 +1,80 @@
 #include "opponent.hpp"
 #include "game.hpp"
 #include "map.hpp"
+#include "simd.hpp"
+#include "tracking.hpp"
 #include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <limits>
+#include <utility>
 
 void Opponent::treat_order(const std::string_view& order)
 {
-    silence_used = false;
-    torpedo_used = false;
+    std::string_view args = order;
+    auto next_token = [&args]()
+    {
+        std::size_t begin = std::min(args.find_first_not_of(' '), args.size());
+        std::size_t end = std::min(args.find(' ', begin), args.size());
+        std::string_view token = args.substr(begin, end - begin);
+        args.remove_prefix(end);
+        return token;
+    };
+    auto next_int = [&next_token]()
+    {
+        std::string_view token = next_token();
+        int value = -1;
+        std::from_chars(token.data(), token.data() + token.size(), value);
+        return value;
+    };
 
-    std::istringstream iss(std::string(order.begin(), order.end()));
-    std::string command;
-    iss >> command;
+    std::string_view command = next_token();
     if (command == "SURFACE")
-    {
-        iss >> sector;
-        update_pos_info_with_sector_();
-        relative_path.clear();
-        game().map().clear_visit(id);
-    }
+        record_(Observation::surface(next_int()));
     else if (command == "MOVE")
     {
-        char dir_ch;
-        iss >> dir_ch;
-        Direction dir = char_to_dir(dir_ch);
-        relative_path.push_back(dir);
-        update_pos_info_with_move_dir_(dir);
+        std::string_view dir_token = next_token();
+        record_(Observation::move(char_to_dir(dir_token.empty() ? '?' : dir_token.front())));
     }
     else if (command == "SILENCE")
+        record_(Observation::silence());
+    else if (command == "TORPEDO")
     {
-        relative_path.push_back(Undefined);
-        update_pos_info_with_last_orientation_();
-        silence_used = true;
+        int x = next_int();
+        int y = next_int();
+        record_(Observation::torpedo_launch(Position(x,y)));
     }
-    else if (command == "TORPEDO")
+    else if (command == "SONAR")
+        sonar_sector = next_int();
+    else if (command == "MINE")
+        record_(Observation::mine_drop());
+    else if (command == "TRIGGER")
     {
-        int x = -1;
-        int y = -1;
-        iss >> x >> y;
-        update_pos_info_with_torpedo_(x, y);
-        torpedo_used = true;
+        int x = next_int();
+        int y = next_int();
+        record_(Observation::mine_trigger(Position(x,y)));
     }
 }
 
+void Opponent::update_data_with_sonar_result(int sector, bool found, int path_index)
+{
+    record_(Observation::sonar_result(sector, found, path_index));
+}
+
+void Opponent::update_data_with_hp_loss(const Position& torpedo_target, const Position& mine_position, int damage, int path_index)
+{
+    // Without a blast, the loss is the damage of their SURFACE orders: nothing to learn.
+    bool has_blast = torpedo_target.x >= 0 || mine_position.x >= 0;
+    for (auto iter = observations_.rbegin(); !has_blast && iter != observations_.rend() && iter->path_index >= path_index; ++iter)
+        has_blast = iter->type == Observation::Torpedo_launch || iter->type == Observation::Mine_trigger;
+    if (has_blast)
+        record_(Observation::hp_loss(torpedo_target, mine_position, damage, path_index));
+}
+
 void Opponent::update_data_with_orders(const std::string& orders)
 {
     trace();
+    sonar_sector = -1;
     std::size_t index = 0;
     std::size_t end_index = 0;
     for (; index < orders.length(); index = end_index + 1)
@@ -64,7 +94,8 @@ void Opponent::init()
     const Map& map = game().map();
 
     mark_map_.set_sector_size(map.sector_width(), map.sector_height());
-    mark_map_.resize(map.width(), map.height(), 0);
+    mark_map_.resize(map.width(), map.height(), 0, -2);
+    assert(mark_map_.padded_size() == map.padded_size());
     for (int j = 0; j < mark_map_.height(); ++j)
     {
         for (int i = 0; i < mark_map_.width(); ++i)
@@ -73,245 +104,816 @@ void Opponent::init()
                 mark_map_.get(i,j) = -2;
         }
     }
+    next_mark_map_ = mark_map_;
+    current_mark_ = 0;
+    candidate_indices_.reserve(map.padded_size());
+    next_candidate_indices_.reserve(map.padded_size());
+    sector_counts_.assign(map.dimensions().number_of_sectors(), 0);
+    next_sector_counts_ = sector_counts_;
+    weight_map_.resize(map.width(), map.height(), 0);
+    next_weight_map_ = weight_map_;
+    sector_weights_.assign(sector_counts_.size(), 0);
+    land_cells_ = Bitboard(map.padded_size());
+    for (int index = 0; index < map.padded_size(); ++index)
+        if (!map.ocean_cells().test(index))
+            land_cells_.set(index);
+    for (unsigned i = 0; i < number_of_directions(); ++i)
+    {
+        Direction dir = Direction(i);
+        silence_ray_cells_[dir].assign(map.padded_size(), Bitboard(map.padded_size()));
+        map.ocean_cells().for_each([&](int index)
+        {
+            for (int distance = 1, nindex = index + map.neighbour_offset(dir); distance <= Silence::max_distance(); ++distance, nindex += map.neighbour_offset(dir))
+                if (nindex >= 0 && nindex < map.padded_size())
+                    silence_ray_cells_[dir][index].set(nindex);
+        });
+    }
+    trail_map_.assign(map.padded_size(), land_cells_);
+    next_trail_map_ = trail_map_;
+    invalidate_candidates();
+    reset_weights_();
+    reset_trails_();
+    observations_.reserve(1024);
+    pending_observations_.reserve(16);
+    for (Snapshot& snapshot : snapshots_)
+        snapshot = Snapshot{ -1, 0, Bitboard(map.padded_size()) };
+    path_length_ = 0;
+    take_snapshot_(0);
+    // A MINE every 4 turns at most, over 300 turns.
+    mine_drop_cells_.reserve(80);
+    mine_drop_trigger_.reserve(80);
+    mine_triggers_.reserve(80);
+    possible_mine_cells_ = Bitboard(map.padded_size());
+    probable_mine_cells_ = Bitboard(map.padded_size());
 }
 
-void Opponent::update_pos_info_with_torpedo_(int x, int y)
+//-----
+
+void Opponent::record_(const Observation& observation)
 {
-    const Game& game = this->game();
-    const Map& map = game.map();
-    int previous_mark = relative_path.size();
+    observations_.push_back(observation);
+    if (observations_.back().path_index < 0)
+        observations_.back().path_index = path_length_;
+    if (observation.changes_path())
+    {
+        // A replay already applies the new observation, the last one of the log.
+        if (!apply_pending_observations() && !apply_(observations_.size() - 1))
+            replay_();
+    }
+    else
+        pending_observations_.push_back(observations_.size() - 1);
+}
 
-    std::vector<Position> squares = map.reachable_squares(Position(x,y), Torpedo::max_radius());
+bool Opponent::apply_pending_observations()
+{
+    // Cheapest first, in order of arrival for equal costs (std::stable_sort would allocate).
+    std::sort(pending_observations_.begin(), pending_observations_.end(), [this](std::size_t lhs, std::size_t rhs)
+    {
+        return std::make_pair(observations_[lhs].cost(), lhs) < std::make_pair(observations_[rhs].cost(), rhs);
+    });
+    for (std::size_t index : pending_observations_)
+    {
+        if (!apply_(index))
+        {
+            pending_observations_.clear();
+            replay_();
+            return true;
+        }
+    }
+    pending_observations_.clear();
+    return false;
+}
 
-    for (int j = 0; j < mark_map_.height(); ++j)
+bool Opponent::apply_(std::size_t observation_index)
+{
+    const Observation& observation = observations_[observation_index];
+    bool is_applied = true;
+    if (observation.is_about_mines())
+        update_mine_cells_(observation);
+    else if (observation.type == Observation::Hp_loss)
+        is_applied = attribute_hp_loss_(observation, observation_index);
+    else if (!observation.changes_path() && observation.path_index < path_length_)
+        is_applied = constrain_past_(observation.path_index, observation_cells_(observation), observation_index);
+    else
     {
-        for (int i = 0; i < mark_map_.width(); ++i)
+        switch (observation.type)
+        {
+        case Observation::Move:
+            is_applied = update_pos_info_with_move_dir_(observation.dir);
+            break;
+        case Observation::Surface:
+            sector = observation.sector;
+            is_applied = update_pos_info_with_sector_();
+            game().map().clear_visit(id);
+            break;
+        case Observation::Silence:
+            is_applied = update_pos_info_with_silence_();
+            break;
+        case Observation::Sonar_result:
+            is_applied = update_pos_info_with_sonar_(observation.sector, observation.value);
+            break;
+        case Observation::Torpedo_launch:
         {
-            Position pos(i,j);
-            auto& mark = mark_map_.get(pos);
-            if (mark == previous_mark && std::find(squares.begin(), squares.end(), pos) == squares.end())
-                mark = -1;
+            Bitboard cells = observation_cells_(observation);
+            is_applied = keep_candidates_if_([&](int index) { return cells.test(index); });
+            break;
+        }
+        case Observation::Hp_loss:
+        case Observation::Mine_drop:
+        case Observation::Mine_trigger:
+            break;
         }
     }
+    if (is_applied && weighted_tracking)
+        normalize_weights_();
+    if (observation.changes_path())
+    {
+        ++path_length_;
+        take_snapshot_(observation_index + 1);
+    }
+    invalidate_summary();
+    return is_applied;
 }
 
-std::vector<Position> Opponent::silence_destinations_(Position origin, Direction orientation, const std::vector<Position>& prpos) const
+Bitboard Opponent::observation_cells_(const Observation& observation) const
 {
     const Map& map = game().map();
+    switch (observation.type)
+    {
+    case Observation::Surface:
+        return map.sector_cells(observation.sector);
+    case Observation::Sonar_result:
+    {
+        Bitboard cells = map.ocean_cells();
+        if (observation.value)
+            return cells &= map.sector_cells(observation.sector);
+        return cells.subtract(map.sector_cells(observation.sector));
+    }
+    case Observation::Torpedo_launch:
+        return torpedo_origin_cells(map, observation.position);
+    default:
+        return map.ocean_cells();
+    }
+}
 
-    Direction opposed_dir = opposed_direction(orientation);
-    std::vector<Position> sdests;
-    sdests.push_back(origin);
-    for (unsigned i = 0; i < number_of_directions(); ++i)
+void Opponent::update_mine_cells_(const Observation& observation)
+{
+    const Map& map = game().map();
+    if (observation.type == Observation::Mine_drop)
     {
-        Direction dir = Direction(i);
-        if (dir != opposed_dir)
+        // The positions of the time of the drop: the current ones, or a snapshot when the drop was
+        // followed by a path order in the same turn.
+        Bitboard positions = map.ocean_cells();
+        if (observation.path_index >= path_length_)
+            positions = possible_positions();
+        else if (const Snapshot& snapshot = snapshots_[observation.path_index % snapshots_.size()]; snapshot.path_index == observation.path_index)
+            positions = snapshot.positions;
+        mine_drop_cells_.push_back(::mine_drop_cells(map, positions));
+        mine_drop_trigger_.push_back(-1);
+    }
+    else
+    {
+        int index = map.contains(observation.position) ? map.index(observation.position) : -1;
+        mine_triggers_.push_back(Mine_trigger{ index, mine_drop_cells_.size() });
+        Turn_vector<char> is_visited(mine_drop_cells_.size(), 0, turn_resource());
+        if (index < 0 || !attribute_trigger_(mine_triggers_.size() - 1, is_visited))
+        {
+            // The tracker missed the drop: the oldest mine left is the one gone.
+            info() << "Opponent tracker: no mine of theirs could lie on " << observation.position << std::endl;
+            auto iter = std::find(mine_drop_trigger_.begin(), mine_drop_trigger_.end(), -1);
+            if (iter != mine_drop_trigger_.end())
+                *iter = static_cast<int>(mine_triggers_.size() - 1);
+        }
+    }
+
+    // A mine left may not lie on a square triggered after its drop: the mine triggered there was
+    // another one.
+    possible_mine_cells_.clear();
+    probable_mine_cells_.clear();
+    for (std::size_t drop = 0; drop < mine_drop_cells_.size(); ++drop)
+    {
+        if (mine_drop_trigger_[drop] >= 0)
+            continue;
+        Bitboard cells = mine_drop_cells_[drop];
+        for (const Mine_trigger& trigger : mine_triggers_)
+            if (trigger.number_of_drops > drop && trigger.index >= 0)
+                cells.reset(trigger.index);
+        possible_mine_cells_ |= cells;
+        if (cells.count() <= max_probable_mine_cells())
+            probable_mine_cells_ |= cells;
+    }
+}
+
+bool Opponent::attribute_trigger_(std::size_t trigger, Turn_vector<char>& is_visited)
+{
+    const Mine_trigger& record = mine_triggers_[trigger];
+    if (record.index < 0)
+        return false;
+    while (true)
+    {
+        // The mine with the fewest squares not tried yet: the likeliest to have been on this one.
+        int best_drop = -1;
+        std::size_t best_count = std::numeric_limits<std::size_t>::max();
+        for (std::size_t drop = 0; drop < record.number_of_drops; ++drop)
         {
-            Position rnpos(0,0);
-            for (unsigned j = 1; j <= 4; ++j)
+            if (is_visited[drop] || !mine_drop_cells_[drop].test(record.index))
+                continue;
+            std::size_t count = mine_drop_cells_[drop].count();
+            if (count < best_count)
             {
-                rnpos.move(dir);
-                Position npos = rnpos + origin;
-                if (!map.contains(npos) || std::find(prpos.begin(), prpos.end(), rnpos) != prpos.end())
-                    break;
-                const Square& square = map.get(npos);
-                if (square.is_ocean() && !square.is_visited(id))
-                    sdests.push_back(npos);
-                else
-                    break;
+                best_drop = static_cast<int>(drop);
+                best_count = count;
             }
         }
+        if (best_drop < 0)
+            return false;
+        is_visited[best_drop] = 1;
+        int& attributed_trigger = mine_drop_trigger_[best_drop];
+        if (attributed_trigger < 0 || attribute_trigger_(attributed_trigger, is_visited))
+        {
+            attributed_trigger = static_cast<int>(trigger);
+            return true;
+        }
     }
-    return sdests;
 }
 
-void Opponent::update_pos_info_with_last_orientation_()
+void Opponent::take_snapshot_(std::size_t observation_count)
+{
+    Snapshot& snapshot = snapshots_[path_length_ % snapshots_.size()];
+    snapshot.path_index = path_length_;
+    snapshot.observation_count = observation_count;
+    snapshot.positions.clear();
+    for (int index : candidate_indices())
+        snapshot.positions.set(index);
+}
+
+bool Opponent::constrain_past_(int path_index, const Bitboard& cells, std::size_t observation_index)
 {
-//    trace();
     const Map& map = game().map();
-    int previous_mark = relative_path.size() - 1;
-    Direction last_dir = relative_path.back();
-    std::vector<Position> prpos = previous_relative_positions();
+    const Snapshot& snapshot = snapshots_[path_index % snapshots_.size()];
+    if (snapshot.path_index != path_index)
+    {
+        info() << "Opponent tracker: no snapshot left for path index " << path_index << std::endl;
+        return true;
+    }
+    Damage_layers layers;
+    layers.fill(Bitboard(map.padded_size()));
+    layers[0] = snapshot.positions & cells;
+    if (layers[0].none() || !replay_layers_(path_index, layers, observation_index, false))
+        return false;
+    const Bitboard& positions = layers[0];
+    return keep_candidates_if_([&](int index) { return positions.test(index); });
+}
 
-    unsigned mark_count = 0;
-    Position last_pos;
-    Mark_map next_mark_map(mark_map_);
-    for (int j = 0; j < mark_map_.height(); ++j)
+bool Opponent::attribute_hp_loss_(const Observation& observation, std::size_t observation_index)
+{
+    const Map& map = game().map();
+    if (observation.value < 0 || observation.value > max_attributed_damage)
+        return true;
+    const Snapshot& snapshot = snapshots_[observation.path_index % snapshots_.size()];
+    if (snapshot.path_index != observation.path_index)
     {
-        for (int i = 0; i < mark_map_.width(); ++i)
+        info() << "Opponent tracker: no snapshot left for path index " << observation.path_index << std::endl;
+        return true;
+    }
+    Damage_layers layers;
+    layers.fill(Bitboard(map.padded_size()));
+    layers[0] = snapshot.positions;
+    if (map.contains(observation.position))
+        add_blast_damage_(map, layers, observation.position);
+    if (map.contains(observation.mine_position))
+        add_blast_damage_(map, layers, observation.mine_position);
+    if (!replay_layers_(observation.path_index, layers, observation_index, true))
+        return false;
+    const Bitboard& positions = layers[observation.value];
+    return keep_candidates_if_([&](int index) { return positions.test(index); });
+}
+
+void Opponent::add_blast_damage_(const Map& map, Damage_layers& layers, const Position& target)
+{
+    Bitboard direct_hit_cells = blast_damage_cells(map, target, 2);
+    Bitboard blast_cells = blast_damage_cells(map, target, 1);
+    // From the top down, so that each position moves once. The ones pushed past the last layer
+    // are dropped: no damage that large is attributed.
+    for (int damage = max_attributed_damage; damage >= 0; --damage)
+    {
+        Bitboard& layer = layers[damage];
+        if (damage + 2 <= max_attributed_damage)
+            layers[damage + 2] |= layer & direct_hit_cells;
+        if (damage + 1 <= max_attributed_damage)
+            layers[damage + 1] |= layer & blast_cells;
+        layer.subtract(direct_hit_cells).subtract(blast_cells);
+    }
+}
+
+bool Opponent::replay_layers_(int path_index, Damage_layers& layers, std::size_t observation_index, bool counts_damage) const
+{
+    const Map& map = game().map();
+    const Snapshot& snapshot = snapshots_[path_index % snapshots_.size()];
+    assert(snapshot.path_index == path_index);
+    auto for_each_layer = [&layers](auto&& function)
+    {
+        for (Bitboard& layer : layers)
+            if (layer.any())
+                function(layer);
+    };
+
+    // The path since the last SURFACE, as it was when the snapshot was taken.
+    Turn_vector<Direction> path(turn_resource());
+    for (std::size_t i = snapshot.observation_count; i-- > 0 && observations_[i].type != Observation::Surface;)
+        if (observations_[i].changes_path())
+            path.push_back(observations_[i].type == Observation::Move ? observations_[i].dir : Undefined);
+    std::reverse(path.begin(), path.end());
+
+    // Replays on the bitboards the observations made since, up to observation_index.
+    int step = path_index;
+    for (std::size_t i = snapshot.observation_count; i < observation_index; ++i)
+    {
+        const Observation& observation = observations_[i];
+        switch (observation.type)
         {
-            Position pos(i,j);
-            if (mark_map_.get(pos) == previous_mark)
+        case Observation::Move:
+            path.push_back(observation.dir);
+            for_each_layer([&](Bitboard& layer) { propagate_move(map, layer, observation.dir); });
+            break;
+        case Observation::Silence:
+        {
+            path.push_back(Undefined);
+            Silence_rays trail_rays = relative_trail_rays(path);
+            for_each_layer([&](Bitboard& layer) { propagate_silence(map, layer, trail_rays); });
+            break;
+        }
+        case Observation::Surface:
+        {
+            Bitboard cells = observation_cells_(observation);
+            for_each_layer([&](Bitboard& layer) { layer &= cells; });
+            path.clear();
+            if (counts_damage)
             {
-                std::vector<Position> sdests = silence_destinations_(pos, last_dir, prpos);
-                for (const Position& npos : sdests)
-                {
-                    next_mark_map.get(npos) = relative_path.size();
-                    ++mark_count;
-                    last_pos = npos;
-                }
+                // A SURFACE costs them one hit point.
+                std::rotate(layers.rbegin(), layers.rbegin() + 1, layers.rend());
+                layers[0].clear();
             }
+            break;
         }
+        default:
+            if (observation.path_index == step)
+            {
+                Bitboard cells = observation_cells_(observation);
+                if (std::any_of(layers.begin(), layers.end(), [&](const Bitboard& layer) { return layer.intersects(cells); }))
+                    for_each_layer([&](Bitboard& layer) { layer &= cells; });
+                bool is_their_blast = observation.type == Observation::Torpedo_launch || observation.type == Observation::Mine_trigger;
+                if (counts_damage && is_their_blast && map.contains(observation.position))
+                    add_blast_damage_(map, layers, observation.position);
+            }
+        }
+        if (observation.changes_path())
+            ++step;
+        if (std::all_of(layers.begin(), layers.end(), [](const Bitboard& layer) { return layer.none(); }))
+            return false;
     }
-//    debug() << mark_map_ << std::endl;
-//    debug() << next_mark_map << std::endl;
-    mark_map_ = next_mark_map;
-    //TODO if mark_count > 1 && all marked squares are in the same sector:
-    //         sector = visited_sector;
+    return true;
+}
 
-    if (mark_count == 1)
+void Opponent::replay_()
+{
+    info() << "Opponent tracker: no possible position left, replaying " << observations_.size() << " observations." << std::endl;
+    // The loss of hit points is the only observation which may be wrongly attributed (to a blast
+    // we missed): if an order of the opponent had to be skipped, replay again without it.
+    for (bool with_impacts : { true, false })
     {
-        position() = last_pos;
-        sector = map.position_to_sector_index(last_pos);
+        reset_candidates_();
+        mine_drop_cells_.clear();
+        mine_drop_trigger_.clear();
+        mine_triggers_.clear();
+        path_length_ = 0;
+        for (Snapshot& snapshot : snapshots_)
+            snapshot.path_index = -1;
+        take_snapshot_(0);
+        std::size_t number_of_skipped_orders = 0;
+        for (std::size_t index = 0; index < observations_.size(); ++index)
+        {
+            const Observation& observation = observations_[index];
+            if (observation.type == Observation::Hp_loss && !with_impacts)
+                continue;
+            if (!apply_(index))
+            {
+                info() << "Opponent tracker: skipped observation " << index << std::endl;
+                if (observation.type != Observation::Hp_loss)
+                    ++number_of_skipped_orders;
+            }
+        }
+        if (number_of_skipped_orders == 0)
+            break;
     }
 }
 
-void Opponent::update_pos_info_with_sector_()
+const std::vector<int>& Opponent::candidate_indices() const
 {
-//    trace();
-    const Map& map = game().map();
-    int previous_mark = relative_path.size();
-
-    Position origin = map.sector_origin(sector);
-    unsigned mark_count = 0;
-    Position last_pos;
-    for (int j = 0; j < map.sector_height(); ++j)
+    if (!candidates_are_valid_)
     {
-        for (int i = 0; i < map.sector_width(); ++i)
+        const Map& map = game().map();
+        candidate_indices_.clear();
+        map.with_dimensions([&](const auto& dims)
         {
-            Position pos = Position(i,j) + origin;
-            if (mark_map_.get(pos) == previous_mark)
+            for (int j = 0; j < dims.height(); ++j)
             {
-                mark_map_.get(pos) = 0;
-                ++mark_count;
-                last_pos = pos;
+                int row_index = dims.index(0, j);
+                simd::for_each_equal(mark_map_.data() + row_index, dims.width(), current_mark_, [&](int i)
+                {
+                    candidate_indices_.push_back(row_index + i);
+                });
             }
-            else if (map.get(pos).is_ocean())
-                mark_map_.get(pos) = -1;
-        }
+        });
+        std::fill(sector_counts_.begin(), sector_counts_.end(), 0);
+        for (int index : candidate_indices_)
+            ++sector_counts_[map.sector_of(index) - 1];
+        candidates_are_valid_ = true;
     }
-    for (int i = 1; i <= mark_map_.number_of_sectors(); ++i)
-        if (i != sector)
-            mark_map_.fill_sector_if(i, -1, 0);
-    if (mark_count == 1)
-        position() = last_pos;
+    return candidate_indices_;
+}
+
+Bitboard Opponent::possible_positions() const
+{
+    Bitboard positions(mark_map_.padded_size());
+    for (int index : candidate_indices())
+        positions.set(index);
+    return positions;
+}
+
+void Opponent::reset_candidates_()
+{
+    prepare_next_mark_();
+    ++current_mark_;
+    game().map().with_dimensions([&](const auto& dims)
+    {
+        for (int j = 0; j < dims.height(); ++j)
+            simd::replace_not_equal(mark_map_.data() + dims.index(0, j), dims.width(), -2, current_mark_);
+    });
+    invalidate_candidates();
+    reset_weights_();
+    reset_trails_();
+}
+
+// Renumbers the marks before they overflow: the possible positions get 0, the other ocean squares -1.
+void Opponent::prepare_next_mark_()
+{
+    if (current_mark_ < std::numeric_limits<int16_t>::max() - 1)
+        return;
+    candidate_indices();
+    game().map().with_dimensions([&](const auto& dims)
+    {
+        for (int j = 0; j < dims.height(); ++j)
+        {
+            simd::replace_not_equal(mark_map_.data() + dims.index(0, j), dims.width(), -2, -1);
+            simd::replace_not_equal(next_mark_map_.data() + dims.index(0, j), dims.width(), -2, -1);
+        }
+    });
+    for (int index : candidate_indices_)
+        mark_map_[index] = 0;
+    current_mark_ = 0;
+}
+
+void Opponent::swap_mark_maps_()
+{
+    assert(current_mark_ < std::numeric_limits<int16_t>::max());
+    std::swap(mark_map_, next_mark_map_);
+    std::swap(candidate_indices_, next_candidate_indices_);
+    std::swap(sector_counts_, next_sector_counts_);
+    std::swap(weight_map_, next_weight_map_);
+    std::swap(trail_map_, next_trail_map_);
+    ++current_mark_;
+    candidates_are_valid_ = true;
+    weights_are_summed_ = false;
+}
+
+template <class Predicate>
+bool Opponent::keep_candidates_if_(Predicate predicate)
+{
+    const Map& map = game().map();
+    const std::vector<int>& candidates = candidate_indices();
+    if (std::none_of(candidates.begin(), candidates.end(), predicate))
+        return false;
+    auto iter = std::remove_if(candidate_indices_.begin(), candidate_indices_.end(), [&](int index)
+    {
+        if (predicate(index))
+            return false;
+        mark_map_[index] = -1;
+        --sector_counts_[map.sector_of(index) - 1];
+        return true;
+    });
+    candidate_indices_.erase(iter, candidate_indices_.end());
+    weights_are_summed_ = false;
+    return true;
 }
 
-void Opponent::update_pos_info_with_move_dir_(Direction dir)
+bool Opponent::update_pos_info_with_sonar_(int sector, bool found)
+{
+    const Map& map = game().map();
+    const Bitboard& sector_cells = map.sector_cells(sector);
+    std::size_t count_in_sector = number_of_possible_positions_in_sector(sector);
+    if (found && count_in_sector < candidate_indices().size())
+        return keep_candidates_if_([&](int index) { return sector_cells.test(index); });
+    if (!found && count_in_sector > 0)
+        return keep_candidates_if_([&](int index) { return !sector_cells.test(index); });
+    return true;
+}
+
+int Opponent::silence_ray_length_(int index, Direction dir) const
+{
+    // The nearest square of the trail on the ray stops it: the trail holds land, so rays never
+    // cross the border of the map.
+    Bitboard blocked_cells = silence_ray_cells_[dir][index] & trail_map_[index];
+    if (blocked_cells.none())
+        return Silence::max_distance();
+    int offset = game().map().neighbour_offset(dir);
+    int nearest_index = offset > 0 ? blocked_cells.first() : blocked_cells.last();
+    return (nearest_index - index) / offset - 1;
+}
+
+bool Opponent::update_pos_info_with_silence_()
 {
 //    trace();
     const Map& map = game().map();
-    int previous_mark = relative_path.size() - 1;
 
-    unsigned mark_count = 0;
-    Position last_pos;
-    Mark_map next_mark_map(mark_map_);
-    for (int j = 0; j < mark_map_.height(); ++j)
+    prepare_next_mark_();
+    int16_t next_mark = current_mark_ + 1;
+    next_candidate_indices_.clear();
+    std::fill(next_sector_counts_.begin(), next_sector_counts_.end(), 0);
+    for (int index : candidate_indices())
     {
-        for (int i = 0; i < mark_map_.width(); ++i)
+        std::array<int, 4> ray_lengths;
+        // The weight of the origin is shared among its destinations in proportion to the prior
+        // of their distance.
+        uint64_t prior_sum = silence_length_prior[0];
+        for (unsigned i = 0; i < number_of_directions(); ++i)
+        {
+            ray_lengths[i] = silence_ray_length_(index, Direction(i));
+            for (int distance = 1; distance <= ray_lengths[i]; ++distance)
+                prior_sum += silence_length_prior[distance];
+        }
+        // A destination reached from several origins keeps the squares of their trails in common.
+        auto add_destination = [&](int nindex, int distance, const Bitboard& trail)
         {
-            Position pos(i,j);
-            Position npos = pos.neighbour(dir);
-            if (mark_map_.get(pos) == previous_mark && map.contains(npos) && map.get(npos).is_ocean())
+            Weight weight = 0;
+            if (weighted_tracking)
             {
-                next_mark_map.get(npos) = relative_path.size();
-                ++mark_count;
-                last_pos = npos;
+                uint64_t share = prior_sum > 0 ? weight_map_[index] * uint64_t(silence_length_prior[distance]) / prior_sum : 0;
+                weight = std::max<Weight>(share, 1);
+            }
+            if (next_mark_map_[nindex] != next_mark)
+            {
+                next_mark_map_[nindex] = next_mark;
+                next_weight_map_[nindex] = weight;
+                next_trail_map_[nindex] = trail;
+                next_candidate_indices_.push_back(nindex);
+                ++next_sector_counts_[map.sector_of(nindex) - 1];
+            }
+            else
+            {
+                next_weight_map_[nindex] += weight;
+                next_trail_map_[nindex] &= trail;
+            }
+        };
+        // A SILENCE of length 0 stays on the origin.
+        add_destination(index, 0, trail_map_[index]);
+        for (unsigned i = 0; i < number_of_directions(); ++i)
+        {
+            int offset = map.neighbour_offset(Direction(i));
+            Bitboard trail = trail_map_[index];
+            for (int distance = 1, nindex = index + offset; distance <= ray_lengths[i]; ++distance, nindex += offset)
+            {
+                trail.set(nindex);
+                add_destination(nindex, distance, trail);
             }
         }
     }
-    mark_map_ = next_mark_map;
+    if (next_candidate_indices_.empty())
+        return false;
+    swap_mark_maps_();
     //TODO if mark_count > 1 && all marked squares are in the same sector:
     //         sector = visited_sector;
 
-    if (mark_count == 1)
+    if (candidate_indices_.size() == 1)
     {
-        position() = last_pos;
-        sector = map.position_to_sector_index(last_pos);
+        set_position(map.position(candidate_indices_.front()));
+        sector = map.sector_of(candidate_indices_.front());
     }
+    return true;
 }
 
-int Opponent::most_marked_sector() const
+bool Opponent::update_pos_info_with_sector_()
 {
 //    trace();
-    int res_sector = 1;
-    std::size_t count = mark_map_.count_in_sector(res_sector, relative_path.size());
-    for (int sector = 1; sector <= mark_map_.number_of_sectors(); ++sector)
+    const Map& map = game().map();
+
+    if (!keep_candidates_if_([&](int index) { return map.sector_of(index) == sector; }))
+        return false;
+    reset_trails_();
+    if (candidate_indices_.size() == 1)
+        set_position(map.position(candidate_indices_.front()));
+    return true;
+}
+
+bool Opponent::update_pos_info_with_move_dir_(Direction dir)
+{
+//    trace();
+    const Map& map = game().map();
+
+    prepare_next_mark_();
+    int16_t next_mark = current_mark_ + 1;
+    int offset = map.neighbour_offset(dir);
+    next_candidate_indices_.clear();
+    std::fill(next_sector_counts_.begin(), next_sector_counts_.end(), 0);
+    for (int index : candidate_indices())
     {
-        std::size_t cnt = mark_map_.count_in_sector(sector, relative_path.size());
-        if (cnt > count)
+        // Land and the trail of the hypothesis are ruled out alike.
+        int nindex = index + offset;
+        if (!trail_map_[index].test(nindex))
         {
-            count = cnt;
-            res_sector = sector;
+            next_mark_map_[nindex] = next_mark;
+            next_weight_map_[nindex] = weight_map_[index];
+            next_trail_map_[nindex] = trail_map_[index];
+            next_trail_map_[nindex].set(nindex);
+            next_candidate_indices_.push_back(nindex);
+            ++next_sector_counts_[map.sector_of(nindex) - 1];
         }
     }
-    return res_sector;
+    if (next_candidate_indices_.empty())
+        return false;
+    swap_mark_maps_();
+    //TODO if mark_count > 1 && all marked squares are in the same sector:
+    //         sector = visited_sector;
+
+    if (candidate_indices_.size() == 1)
+    {
+        set_position(map.position(candidate_indices_.front()));
+        sector = map.sector_of(candidate_indices_.front());
+    }
+    return true;
 }
 
-std::size_t Opponent::number_of_possible_positions() const
+double Opponent::expected_positions_after_sonar(int sector) const
 {
-    return mark_map_.count(relative_path.size());
+    Weight total_weight = this->total_weight();
+    if (total_weight == 0)
+        return 0;
+    double count = number_of_possible_positions();
+    double in_sector = number_of_possible_positions_in_sector(sector);
+    double probability = double(sector_weights()[sector - 1]) / total_weight;
+    return probability * in_sector + (1 - probability) * (count - in_sector);
 }
 
-std::vector<Position> Opponent::previous_relative_positions() const
+int Opponent::best_sonar_sector() const
 {
-    std::vector<Position> vpos;
-    Position pos(0,0);
-    for (auto iter = relative_path.rbegin() + 1, end_iter = relative_path.rend(); iter != end_iter; ++iter)
+    int number_of_sectors = static_cast<int>(sector_counts().size());
+    int best_sector = 1;
+    double best_expected_count = expected_positions_after_sonar(best_sector);
+    for (int sector = 2; sector <= number_of_sectors; ++sector)
     {
-        Direction dir = *iter;
-        if (!dir_is_valid(dir))
-            break;
-        pos.move(opposed_direction(dir));
-        vpos.push_back(pos);
+        double expected_count = expected_positions_after_sonar(sector);
+        // Ties (up to rounding) go to the first sector.
+        if (expected_count < best_expected_count - 1e-9)
+        {
+            best_sector = sector;
+            best_expected_count = expected_count;
+        }
     }
-    return vpos;
+    return best_sector;
 }
 
-void Opponent::update_position()
+double Opponent::best_sonar_gain() const
 {
-    std::size_t pos_count = number_of_possible_positions();
-    if (pos_count == 1)
+    return number_of_possible_positions() - expected_positions_after_sonar(best_sonar_sector());
+}
+
+const std::vector<int>& Opponent::sector_counts() const
+{
+    candidate_indices();
+    return sector_counts_;
+}
+
+Opponent::Weight Opponent::weight(int index) const
+{
+    if (mark_map_[index] != current_mark_)
+        return 0;
+    return weighted_tracking ? weight_map_[index] : 1;
+}
+
+Opponent::Weight Opponent::total_weight() const
+{
+    sector_weights();
+    return total_weight_;
+}
+
+const std::vector<Opponent::Weight>& Opponent::sector_weights() const
+{
+    if (!weights_are_summed_)
     {
-        for (int j = 0; j < mark_map_.width(); ++j)
+        const Map& map = game().map();
+        const std::vector<int>& candidates = candidate_indices();
+        if (weighted_tracking)
         {
-            for (int i = 0; i < mark_map_.width(); ++i)
+            std::fill(sector_weights_.begin(), sector_weights_.end(), 0);
+            total_weight_ = 0;
+            for (int index : candidates)
             {
-                if (mark_map_.get(i,j) == static_cast<int>(relative_path.size()))
-                    position() = Position(i,j);
+                sector_weights_[map.sector_of(index) - 1] += weight_map_[index];
+                total_weight_ += weight_map_[index];
             }
         }
+        else
+        {
+            std::copy(sector_counts_.begin(), sector_counts_.end(), sector_weights_.begin());
+            total_weight_ = static_cast<Weight>(candidates.size());
+        }
+        weights_are_summed_ = true;
     }
-    else
-        position() = Position(-1,-1);
+    return sector_weights_;
 }
 
-Position Opponent::center_of_possible_positions() const
+void Opponent::reset_weights_()
 {
-//    trace();
-    int current_mark = relative_path.size();
+    if (!weighted_tracking)
+        return;
+    const Map& map = game().map();
+    std::size_t number_of_positions = std::max<std::size_t>(map.ocean_cells().count(), 1);
+    Weight weight = static_cast<Weight>(weight_one() / number_of_positions + 1);
+    for (int index : candidate_indices())
+        weight_map_[index] = weight;
+    weights_are_summed_ = false;
+}
 
-    std::vector<Position> vpos;
-    for (int j = 0; j < mark_map_.height(); ++j)
+void Opponent::reset_trails_()
+{
+    for (int index : candidate_indices())
     {
-        for (int i = 0; i < mark_map_.width(); ++i)
+        trail_map_[index] = land_cells_;
+        trail_map_[index].set(index);
+    }
+}
+
+void Opponent::normalize_weights_()
+{
+    Weight total_weight = this->total_weight();
+    if (total_weight == 0)
+        return;
+    int shift = 0;
+    for (; total_weight >= 2 * weight_one(); total_weight >>= 1)
+        ++shift;
+    for (; total_weight < weight_one(); total_weight <<= 1)
+        --shift;
+    if (shift > 0)
+        simd::shift_right_rounding_up(weight_map_.data(), weight_map_.padded_size(), shift);
+    else if (shift < 0)
+        simd::shift_left(weight_map_.data(), weight_map_.padded_size(), -shift);
+    if (shift != 0)
+        weights_are_summed_ = false;
+}
+
+std::size_t Opponent::number_of_possible_positions() const
+{
+    return candidate_indices().size();
+}
+
+const Opponent::Summary& Opponent::summary() const
+{
+    if (summary_is_valid_)
+        return summary_;
+
+    Summary& summary = summary_;
+    summary.count = 0;
+    summary.min_corner = Position(std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
+    game().map().with_dimensions([&](const auto& dims)
+    {
+        for (int index : candidate_indices())
         {
-            if (mark_map_.get(i,j) == current_mark)
-            {
-                vpos.push_back(Position(i,j));
-                if (vpos.size() > 9)
-                    return Position(-1,-1);
-            }
+            Position pos = dims.position(index);
+            ++summary.count;
+            summary.min_corner = Position(std::min(summary.min_corner.x, pos.x), std::min(summary.min_corner.y, pos.y));
         }
-    }
-    if (vpos.empty())
-        return Position(-1,-1); //TODO should not happen
-    Position center(0,0);
-    for (const Position& pos : vpos)
-        center += pos;
-    debug() << "vpos_size = " << vpos.size() << std::endl;
-    assert(vpos.size());
-    center.x /= vpos.size();
-    center.y /= vpos.size();
-    return center;
+    });
+    if (summary.count == 0)
+        summary.min_corner = Position(-1,-1);
+    summary_is_valid_ = true;
+    return summary_;
+}
+
+void Opponent::update_position()
+{
+    apply_pending_observations();
+    const Summary& summary = this->summary();
+    if (summary.count == 1)
+        set_position(summary.min_corner);
+    else
+        set_position(Position(-1,-1));
+}
+
+int Opponent::number_of_moves_since(Observation::Type type) const
+{
+    int res = 0;
+    for (auto iter = observations_.rbegin(); iter != observations_.rend() && iter->type != type; ++iter)
+        if (iter->type == Observation::Move)
+            ++res;
+    return res;
 }
@@ -2,11 +2,32 @@
 
 #include "player.hpp"
 #include "grid_with_sectors.hpp"
+#include "observation.hpp"
+#include "bitboard.hpp"
+#include "tool.hpp"
+#include "memory.hpp"
+#include <array>
+
+class Map;
 
 class Opponent : public Player
 {
 public:
-    using Mark_map = Grid_with_sectors<int16_t>;
+    using Mark_map = Grid_with_sectors<int16_t, Padded_grid<int16_t>>;
+    // Fixed-point weights, aligned with the mark map. Only the cells of possible positions are meaningful.
+    using Weight = uint32_t;
+    using Weight_map = Padded_grid<Weight>;
+    // After each observation, the weights are scaled by a power of 2 so that their total lies in
+    // [weight_one(), 2 * weight_one()[.
+    inline static constexpr Weight weight_one() { return 1u << 20; }
+
+    // Distribution of the possible positions (squares holding the current mark): their count and
+    // the top-left corner of their bounding box, the position itself when there is a single one.
+    struct Summary
+    {
+        std::size_t count = 0;
+        Position min_corner = Position(-1,-1);
+    };
 
     explicit Opponent(Game& game)
         : Player(game)
@@ -17,36 +38,187 @@ public:
     inline bool sector_is_known() const { return sector >= 0; }
     void reset_sector() { sector = -1; }
 
-    bool silence_used = false;
-    bool torpedo_used = false;
+    int sonar_sector = -1; // sector of the sonar they used during their last turn, if any
+
+    // Weighted tracking: each possible position weighs the number of paths leading to it, a SILENCE
+    // of length d counting for silence_length_prior[d] paths, shared among the destinations of its
+    // origin. Otherwise every possible position weighs 1. Set them before init().
+    bool weighted_tracking = true;
+    std::array<Weight, Silence::max_distance() + 1> silence_length_prior = { 1, 1, 1, 1, 1 };
 
     void treat_order(const std::string_view& order);
 
     void update_data_with_orders(const std::string& orders);
 
-    void update_data_with_sonar_result(int sector, bool found);
+    void update_data_with_sonar_result(int sector, bool found, int path_index);
+
+    // damage: the hit points they lost since our last turn, when we fired a torpedo at torpedo_target
+    // and triggered a mine at mine_position (either one (-1,-1) if not) with path_index path orders
+    // treated. Call it after their orders: ignored when no blast can explain any of it.
+    void update_data_with_hp_loss(const Position& torpedo_target, const Position& mine_position, int damage, int path_index);
+
+    // Applies the observations waiting in the log. Called by update_position(). Returns true when
+    // one of them failed and the whole log was replayed.
+    bool apply_pending_observations();
 
     void update_position();
 
-    int most_marked_sector() const;
+    // Sonar selection from sector_counts() and sector_weights(), in O(number of sectors). A sonar on
+    // a sector holding c of the n possible positions, with a probability p given by their weights,
+    // leaves c of them with probability p and n-c otherwise.
+    double expected_positions_after_sonar(int sector) const;
+    // Sector whose sonar leaves the fewest possible positions on average.
+    int best_sonar_sector() const;
+    // Expected number of possible positions ruled out by a sonar on best_sonar_sector().
+    double best_sonar_gain() const;
 
     std::size_t number_of_possible_positions() const;
 
+    // Kept up to date with the candidate list.
+    const std::vector<int>& sector_counts() const; // sector_counts()[sector - 1]
+    int number_of_possible_positions_in_sector(int sector) const { return sector_counts()[sector - 1]; }
+
+    // Weight of the possible position index, 0 if index is not a possible position.
+    Weight weight(int index) const;
+    // Computed on first use after the weights changed.
+    Weight total_weight() const;
+    const std::vector<Weight>& sector_weights() const; // sector_weights()[sector - 1]
+    double probability(int index) const { return double(weight(index)) / total_weight(); }
+
+    // Squares holding the current mark are the possible positions. Marks only grow, so the
+    // other buffer never holds the next mark before it is written.
+    int current_mark() const { return current_mark_; }
     const Mark_map& mark_map() const { return mark_map_; }
-    Mark_map& mark_map() { return mark_map_; }
 
-    Position center_of_possible_positions() const;
+    const std::vector<int>& candidate_indices() const;
+    Bitboard possible_positions() const;
+
+    // Everything learnt about the opponent since the start of the game, in order.
+    const std::vector<Observation>& observations() const { return observations_; }
+
+    // Number of MOVE, SILENCE and SURFACE orders treated so far. An observation made when the
+    // path had a given length is applied to the possible positions of that time (see Snapshot).
+    int path_length() const { return path_length_; }
+    // Number of MOVE orders since their last order of type (or since the start). Each MOVE charges
+    // one tool: their cooldown of the tool used by type is at least its total cooldown minus this.
+    int number_of_moves_since(Observation::Type type) const;
+
+    // Each TRIGGER is attributed to one of the mines dropped before it which may lie on its square
+    // (next to their possible positions at the drop), the ones with the fewest squares first; an
+    // earlier attribution is moved if needed, so that every TRIGGER keeps its own mine.
+    // Squares which may hold one of their mines still in place.
+    const Bitboard& possible_mine_cells() const { return possible_mine_cells_; }
+    // Squares of the mines which may lie on max_probable_mine_cells() squares at most: each one
+    // holds a mine with a probability of 1 / max_probable_mine_cells() at least.
+    inline static constexpr std::size_t max_probable_mine_cells() { return 4; }
+    const Bitboard& probable_mine_cells() const { return probable_mine_cells_; }
+
+    // Computed on first use after the mark map changed.
+    const Summary& summary() const;
+    void invalidate_summary() { summary_is_valid_ = false; }
 
 private:
-    void update_pos_info_with_torpedo_(int x, int y);
-    std::vector<Position> silence_destinations_(Position origin, Direction dir, const std::vector<Position>& prpos) const;
-    void update_pos_info_with_last_orientation_();
-    void update_pos_info_with_sector_();
-    void update_pos_info_with_move_dir_(Direction dir);
-    std::vector<Position> previous_relative_positions() const;
+    // Each observation is recorded, then applied to the possible positions. Applying one which
+    // would leave no possible position does nothing and returns false: the tracker then replays
+    // the whole log from the start of the game, skipping the observations which contradict the
+    // ones before them.
+    void record_(const Observation& observation);
+    bool apply_(std::size_t observation_index);
+    void replay_();
+
+    // Possible positions at each path index, for the last few ones.
+    struct Snapshot
+    {
+        int path_index = -1;
+        std::size_t observation_count = 0; // number of observations applied when it was taken
+        Bitboard positions;
+    };
+    inline static constexpr std::size_t number_of_snapshots = 16;
+
+    void take_snapshot_(std::size_t observation_count);
+    // Restricts the possible positions at path_index to cells, then moves them forward along the
+    // observations recorded since, up to observation_index, with bitboard operations only.
+    bool constrain_past_(int path_index, const Bitboard& cells, std::size_t observation_index);
+    Bitboard observation_cells_(const Observation& observation) const;
+
+    // Damage attribution: layers[d] holds the positions consistent with d hit points lost. A blast
+    // moves the positions of each layer it hits up by its damage there, so every combination of
+    // the damage sources is enumerated with a few masks per layer.
+    inline static constexpr int max_attributed_damage = 8;
+    using Damage_layers = std::array<Bitboard, max_attributed_damage + 1>;
+    static void add_blast_damage_(const Map& map, Damage_layers& layers, const Position& target);
+    // Moves the layers of positions at path_index forward along the observations recorded since,
+    // up to observation_index, as constrain_past_() does. If counts_damage, the SURFACE orders and
+    // the blasts of their own TORPEDO and TRIGGER orders on the way move them up. False if every
+    // layer empties.
+    bool replay_layers_(int path_index, Damage_layers& layers, std::size_t observation_index, bool counts_damage) const;
+    // Keeps the positions in the layer of the damage observed, if any.
+    bool attribute_hp_loss_(const Observation& observation, std::size_t observation_index);
+
+    // Never fails: the mine observations filter no position.
+    void update_mine_cells_(const Observation& observation);
+    // Augmenting path from the trigger to a mine not attributed yet (bipartite matching).
+    bool attribute_trigger_(std::size_t trigger, Turn_vector<char>& is_visited);
+
+    bool update_pos_info_with_sonar_(int sector, bool found);
+    // Number of squares a SILENCE from index can cross in dir, for the trail of the hypothesis.
+    int silence_ray_length_(int index, Direction dir) const;
+    bool update_pos_info_with_silence_();
+    bool update_pos_info_with_sector_();
+    bool update_pos_info_with_move_dir_(Direction dir);
+    void reset_candidates_();
+    void prepare_next_mark_();
+    void swap_mark_maps_();
+    template <class Predicate>
+    bool keep_candidates_if_(Predicate predicate);
+    void invalidate_candidates() { candidates_are_valid_ = false; summary_is_valid_ = false; weights_are_summed_ = false; }
+    void reset_weights_();
+    // A SURFACE (or the start) leaves each hypothesis with its own square only.
+    void reset_trails_();
+    void normalize_weights_();
+
+    int16_t current_mark_ = 0;
+    Mark_map next_mark_map_;
+    mutable std::vector<int> candidate_indices_;
+    mutable bool candidates_are_valid_ = false;
+    std::vector<int> next_candidate_indices_;
+    mutable std::vector<int> sector_counts_;
+    std::vector<int> next_sector_counts_;
+    Weight_map weight_map_;
+    Weight_map next_weight_map_;
+    // Trail of each hypothesis, aligned with the mark map: the squares it cannot enter, land and
+    // the squares visited since the last SURFACE on every path leading to it. A MOVE into it or a
+    // SILENCE ray crossing it is ruled out with one mask test. Only the cells of possible
+    // positions are meaningful.
+    std::vector<Bitboard> trail_map_;
+    std::vector<Bitboard> next_trail_map_;
+    Bitboard land_cells_;
+    std::array<std::vector<Bitboard>, 4> silence_ray_cells_; // [dir][index]: the squares 1 to Silence::max_distance() steps away
+
+    mutable Weight total_weight_ = 0;
+    mutable std::vector<Weight> sector_weights_;
+    mutable bool weights_are_summed_ = false;
+
+    std::vector<Observation> observations_;
+    std::vector<std::size_t> pending_observations_;
+    int path_length_ = 0;
+    std::array<Snapshot, number_of_snapshots> snapshots_;
+
+    struct Mine_trigger
+    {
+        int index; // square triggered
+        std::size_t number_of_drops; // the mines dropped before it
+    };
+    std::vector<Bitboard> mine_drop_cells_; // by drop, whether triggered or not
+    std::vector<int> mine_drop_trigger_; // by drop: the TRIGGER attributed to it, -1 if none
+    std::vector<Mine_trigger> mine_triggers_;
+    Bitboard possible_mine_cells_;
+    Bitboard probable_mine_cells_;
+
+    mutable Summary summary_;
+    mutable bool summary_is_valid_ = false;
 
 public:
     int sector = -1;
-    std::vector<Direction> relative_path;
     Mark_map mark_map_;
 };
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "vec2.hpp"
+#include "dimensions.hpp"
+#include "simd.hpp"
+#include <algorithm>
+#include <array>
+#include <vector>
+#include <ostream>
+#include <iomanip>
+
+using Position = Vec2;
+using Offset = Vec2;
+
+// Grid stored in one flat row-major buffer surrounded by a border of padding() cells.
+// Filling the border with a sentinel value lets neighbour loops step by a fixed index offset
+// without testing the grid edges: a walk stops on the sentinel before leaving the buffer.
+// The buffer extends tail_padding() cells past the bottom border for the simd kernels.
+template <class Type>
+class Padded_grid
+{
+    using Ref = typename std::vector<Type>::reference;
+    using Const_ref = typename std::vector<Type>::const_reference;
+
+public:
+    inline static constexpr int padding() { return grid_padding(); }
+    inline static constexpr int tail_padding() { return simd::int16_lanes - 1; }
+
+    explicit Padded_grid(int width = 0, int height = 0, const Type& value = Type()) { resize(width, height, value); }
+
+    inline int width() const { return width_; }
+    inline int height() const { return height_; }
+    inline int stride() const { return width_ + 2 * padding(); }
+    inline int padded_size() const { return stride() * (height_ + 2 * padding()); }
+
+    inline int index(int x, int y) const { return (y + padding()) * stride() + x + padding(); }
+    inline int index(const Position& pos) const { return index(pos.x, pos.y); }
+    inline Position position(int index) const { return Position(index % stride() - padding(), index / stride() - padding()); }
+    inline int neighbour_offset(Direction dir) const { return neighbour_offsets_[dir]; }
+    inline const std::array<int, 4>& neighbour_offsets() const { return neighbour_offsets_; }
+
+    inline Const_ref operator[](int index) const { return data_[index]; }
+    inline Ref operator[](int index) { return data_[index]; }
+    inline Const_ref get(int x, int y) const { return data_.at(index(x, y)); }
+    inline Ref get(int x, int y) { return data_.at(index(x, y)); }
+    inline Const_ref get(const Position& pos) const { return get(pos.x, pos.y); }
+    inline Ref get(const Position& pos) { return get(pos.x, pos.y); }
+
+    inline const Type* data() const { return data_.data(); }
+    inline Type* data() { return data_.data(); }
+
+    void clear()
+    {
+        width_ = 0;
+        height_ = 0;
+        data_.clear();
+    }
+
+    void resize(int width, int height, const Type& value = Type())
+    {
+        resize(width, height, value, value);
+    }
+
+    void resize(int width, int height, const Type& value, const Type& border_value)
+    {
+        width_ = width;
+        height_ = height;
+        data_.assign(padded_size() + tail_padding(), border_value);
+        for (int j = 0; j < height_; ++j)
+            std::fill_n(data_.begin() + index(0, j), width_, value);
+        neighbour_offsets_[North] = -stride();
+        neighbour_offsets_[East] = 1;
+        neighbour_offsets_[South] = stride();
+        neighbour_offsets_[West] = -1;
+    }
+
+    bool contains(const Position& pos) const
+    {
+        return pos.x >= 0 && pos.x < width_ && pos.y >= 0 && pos.y < height_;
+    }
+
+    std::size_t count(const Type& value) const
+    {
+        std::size_t res = 0;
+        for (int j = 0; j < height_; ++j)
+            for (int i = 0; i < width_; ++i)
+                if (data_[index(i, j)] == value)
+                    ++res;
+        return res;
+    }
+
+    friend std::ostream& operator<<(std::ostream& stream, const Padded_grid<Type>& grid)
+    {
+        stream << "[GRID:" << grid.width() << " x " << grid.height() << "\n";
+        for (int j = 0; j < grid.height(); ++j)
+        {
+            for (int i = 0; i < grid.width(); ++i)
+                stream << std::setw(2) << grid[grid.index(i, j)] << " ";
+            stream << std::endl;
+        }
+        stream << "]";
+        return stream;
+    }
+
+protected:
+    int width_ = -1;
+    int height_ = -1;
+    std::array<int, 4> neighbour_offsets_ = {};
+    std::vector<Type> data_;
+};
@@ -0,0 +1,192 @@
+#include "path_planner.hpp"
+#include "tracking.hpp"
+#include "map.hpp"
+#include "zobrist.hpp"
+#include <algorithm>
+
+void Path_planner::init(const Map& map)
+{
+    neighbour_offsets_ = map.neighbour_offsets();
+    head_keys_.resize(map.padded_size());
+    for (std::size_t i = 0; i < head_keys_.size(); ++i)
+        head_keys_[i] = zobrist::key(zobrist::Position, i);
+    memo_.assign(memo_size, Memo_entry());
+    generation_ = 0;
+    free_ = Bitboard(map.padded_size());
+    walk_.reserve(map.padded_size());
+    best_walk_.reserve(map.padded_size());
+    plan_.reserve(map.padded_size());
+    plan_start_index_ = -1;
+}
+
+Direction Path_planner::next_direction(const Map& map, int actor_id, const Position& start, Clock::time_point deadline,
+                                       const std::vector<int>& step_costs)
+{
+    map_ = &map;
+    deadline_ = deadline;
+    step_costs_ = &step_costs;
+    is_interrupted_ = false;
+    number_of_nodes_ = 0;
+
+    free_ = map.ocean_cells();
+    map.ocean_cells().for_each([&](int index)
+    {
+        if (map[index].is_visited(actor_id))
+            free_.reset(index);
+    });
+    int start_index = map.index(start);
+    free_.reset(start_index);
+    walk_.clear();
+    walk_key_ = map.visit_key(actor_id);
+    best_walk_.clear();
+    if (plan_is_valid_(start_index))
+        best_walk_ = plan_;
+
+    int bound = walk_bound_(start_index);
+    if (map.regions_actor_id() == actor_id)
+        bound = std::min(bound, map.walk_bound(start_index));
+    int best_length = static_cast<int>(best_walk_.size());
+    for (depth_limit_ = std::max(min_depth_limit, best_length + 1); best_length < bound; depth_limit_ *= 2)
+    {
+        depth_limit_ = std::min(depth_limit_, bound);
+        depth_limit_reached_ = false;
+        ++generation_;
+        search_(start_index, 0);
+        best_length = static_cast<int>(best_walk_.size());
+        if (is_interrupted_ || !depth_limit_reached_ || depth_limit_ == bound)
+            break;
+    }
+
+    if (best_walk_.empty())
+    {
+        plan_.clear();
+        plan_start_index_ = -1;
+        return Bad;
+    }
+    Direction dir = best_walk_.front();
+    plan_.assign(best_walk_.begin() + 1, best_walk_.end());
+    plan_start_index_ = start_index + neighbour_offsets_[dir];
+    return dir;
+}
+
+Bitboard Path_planner::plan_cells(std::size_t max_length) const
+{
+    Bitboard cells(map_ ? map_->padded_size() : 0);
+    if (plan_start_index_ < 0 || max_length == 0)
+        return cells;
+    int index = plan_start_index_;
+    cells.set(index);
+    for (std::size_t i = 0; i + 1 < max_length && i < plan_.size(); ++i)
+    {
+        index += neighbour_offsets_[plan_[i]];
+        cells.set(index);
+    }
+    return cells;
+}
+
+bool Path_planner::plan_is_valid_(int start_index) const
+{
+    if (plan_.empty() || plan_start_index_ != start_index)
+        return false;
+    int index = start_index;
+    for (Direction dir : plan_)
+    {
+        index += neighbour_offsets_[dir];
+        if (!free_.test(index))
+            return false;
+    }
+    return true;
+}
+
+int Path_planner::walk_bound_(int index) const
+{
+    int res = 0;
+    Bitboard reached(free_.size());
+    for (int offset : neighbour_offsets_)
+    {
+        int nindex = index + offset;
+        if (!free_.test(nindex) || reached.test(nindex))
+            continue;
+        Bitboard region(free_.size());
+        region.set(nindex);
+        for (;;)
+        {
+            Bitboard next_region = region;
+            spread(*map_, next_region);
+            next_region &= free_;
+            if (next_region == region)
+                break;
+            region = next_region;
+        }
+        res = std::max(res, static_cast<int>(region.count()));
+        reached |= region;
+    }
+    return res;
+}
+
+int Path_planner::next_steps_(int index, int depth, std::array<Step, 4>& steps) const
+{
+    int number_of_steps = 0;
+    for (unsigned i = 0; i < number_of_directions(); ++i)
+    {
+        int nindex = index + neighbour_offsets_[i];
+        if (!free_.test(nindex))
+            continue;
+        int degree = 0;
+        for (int offset : neighbour_offsets_)
+            degree += free_.test(nindex + offset);
+        int cost = depth == 0 && !step_costs_->empty() ? (*step_costs_)[nindex] : 0;
+        steps[number_of_steps++] = Step{ nindex, Direction(i), cost * int(number_of_directions() + 1) + degree };
+    }
+    std::sort(steps.begin(), steps.begin() + number_of_steps, [](const Step& lhs, const Step& rhs)
+    {
+        return lhs.cost < rhs.cost;
+    });
+    return number_of_steps;
+}
+
+int Path_planner::search_(int index, int depth)
+{
+    if ((++number_of_nodes_ & 63) == 0 && Clock::now() >= deadline_)
+        is_interrupted_ = true;
+    if (is_interrupted_)
+        return 0;
+    if (depth > static_cast<int>(best_walk_.size()))
+        best_walk_ = walk_;
+    if (depth >= depth_limit_)
+    {
+        depth_limit_reached_ = true;
+        return 0;
+    }
+
+    uint64_t key = walk_key_ ^ head_keys_[index];
+    Memo_entry& entry = memo_[key % memo_size];
+    if (entry.generation == generation_ && entry.key == key && depth + entry.bound <= static_cast<int>(best_walk_.size()))
+        return 0;
+    int bound = std::min(walk_bound_(index), depth_limit_ - depth);
+    if (depth + bound <= static_cast<int>(best_walk_.size()))
+        return 0;
+
+    std::array<Step, 4> steps;
+    int number_of_steps = next_steps_(index, depth, steps);
+    int res = 0;
+    for (int i = 0; i < number_of_steps && res < bound; ++i)
+    {
+        const Step& step = steps[i];
+        free_.reset(step.index);
+        walk_key_ ^= map_->cell_key(step.index);
+        walk_.push_back(step.dir);
+        res = std::max(res, 1 + search_(step.index, depth + 1));
+        walk_.pop_back();
+        walk_key_ ^= map_->cell_key(step.index);
+        free_.set(step.index);
+        if (is_interrupted_)
+            return res;
+    }
+
+    // Every walk longer than the best one was searched: none is longer than res.
+    entry.key = key;
+    entry.generation = generation_;
+    entry.bound = std::max(res, static_cast<int>(best_walk_.size()) - depth);
+    return res;
+}
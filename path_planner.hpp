@@ -0,0 +1,89 @@
+#pragma once
+
+#include "bitboard.hpp"
+#include "direction.hpp"
+#include "grid.hpp"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+class Map;
+
+// Searches the longest self-avoiding walk from a position over the squares not visited yet,
+// to delay the next SURFACE as long as possible.
+//
+// The search is a depth-first search on bitboards with:
+// - a bound on the walk left: the largest region reachable from one of the free neighbours
+//   of the head (when the head cuts the free squares in several regions, only one can be used),
+// - a memo of bounds keyed on (head, squares visited or used by the walk), the key of the
+//   squares being Map::visit_key() updated along the walk,
+// - iterative deepening on the walk length, stopped at the deadline, or as soon as a walk reaches
+//   the bound given by the block-cut tree of the map (see Map::walk_bound).
+// The rest of the walk found is kept as a plan: next turn it is the walk to beat.
+class Path_planner
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void init(const Map& map);
+
+    // First direction of the longest walk found from start before deadline, Bad if none.
+    // Among walks of the same length, the first step with the lowest step_costs (indexed by cell
+    // index, empty for none) is preferred.
+    Direction next_direction(const Map& map, int actor_id, const Position& start, Clock::time_point deadline,
+                             const std::vector<int>& step_costs = {});
+
+    // Length of the walk planned by the last call, first step included.
+    std::size_t plan_length() const { return best_walk_.size(); }
+    // Squares of the first max_length steps of that walk, first step included.
+    Bitboard plan_cells(std::size_t max_length) const;
+    std::size_t number_of_searched_nodes() const { return number_of_nodes_; }
+
+private:
+    struct Memo_entry
+    {
+        uint64_t key = 0;
+        uint32_t generation = 0;
+        int bound = 0; // upper bound of the length of the walk left
+    };
+    inline static constexpr std::size_t memo_size = 1 << 16;
+    inline static constexpr int min_depth_limit = 16;
+
+    struct Step
+    {
+        int index;
+        Direction dir;
+        int cost;
+    };
+
+    // Upper bound of the length of a walk leaving index over free_.
+    int walk_bound_(int index) const;
+    // Free neighbours of index, most constrained first (fewest free neighbours of their own),
+    // after the lowest step cost at the start.
+    int next_steps_(int index, int depth, std::array<Step, 4>& steps) const;
+    // Length of the longest walk found from index, depth steps after the start.
+    int search_(int index, int depth);
+    bool plan_is_valid_(int start_index) const;
+
+    std::array<int, 4> neighbour_offsets_ = {};
+    std::vector<uint64_t> head_keys_;
+    std::vector<Memo_entry> memo_;
+    uint32_t generation_ = 0;
+
+    const Map* map_ = nullptr;
+    Bitboard free_;
+    uint64_t walk_key_ = 0;
+    int depth_limit_ = 0;
+    bool depth_limit_reached_ = false;
+    bool is_interrupted_ = false;
+    Clock::time_point deadline_;
+    const std::vector<int>* step_costs_ = nullptr;
+    std::size_t number_of_nodes_ = 0;
+    std::vector<Direction> walk_;
+    std::vector<Direction> best_walk_;
+
+    // Rest of the last walk: valid if we stand on plan_start_index_.
+    std::vector<Direction> plan_;
+    int plan_start_index_ = -1;
+};
@@ -1,7 +1,7 @@
 #pragma once
 
 #include "grid.hpp"
-#include <deque>
+#include <array>
 #include <cassert>
 
 class Game;
@@ -21,27 +21,25 @@ public:
     explicit Player(Game& game);
 
     const Position& position() const { return status.position; }
-    Position& position() { return status.position; }
+    void set_position(const Position& position);
     bool position_is_known() const { return position().x >= 0 && position().y >= 0; }
     const int& hp() const { return status.hp; }
-    int& hp() { return status.hp; }
+    void set_hp(int hp);
 
-    const Status& previous_status() const { return history_status.back(); }
+    const Status& previous_status() const { return history_status[(history_end_ + max_history_size - 1) % max_history_size]; }
     void save_status();
 
     const Game& game() const { assert(game_); return *game_; }
     Game& game() { assert(game_); return *game_; }
 
-    std::vector<Position> sensible_squares() const;
-    std::vector<Position> hitable_squares_by_torpedo() const;
-
     friend std::istream& operator>>(std::istream& stream, Player& info);
 
 private:
     Game* game_ = nullptr;
+    std::size_t history_end_ = 0;
 
 public:
     int id = -1;
     Status status;
-    std::deque<Status> history_status;
+    std::array<Status, max_history_size> history_status; // ring buffer: the latest one before history_end_
 };
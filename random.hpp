@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <random>
 
 namespace priv
@@ -16,3 +17,25 @@ NT randint (NT a, NT b)
 }
 
 
+
+// Xorshift generator for the playouts: a few instructions per number and no shared state, so
+// each thread can own one.
+class Fast_rng
+{
+public:
+    explicit Fast_rng(uint64_t seed) : state_(seed != 0 ? seed : 0x9E3779B97F4A7C15ull) {}
+
+    uint64_t operator()()
+    {
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 7;
+        state_ ^= state_ << 17;
+        return state_;
+    }
+
+    // Uniform in [0, bound[, by multiplication instead of a modulo.
+    uint32_t below(uint32_t bound) { return static_cast<uint32_t>((((*this)() >> 32) * bound) >> 32); }
+
+private:
+    uint64_t state_;
+};
@@ -0,0 +1,243 @@
+#include "rollout.hpp"
+#include "tracking.hpp"
+#include "opponent.hpp"
+#include "map.hpp"
+#include "tool.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <thread>
+
+namespace
+{
+constexpr int max_number_of_threads = 8;
+// Opponent positions sampled for each check of the deadline (for every action).
+constexpr int playout_batch_size = 16;
+}
+
+void Rollout_engine::init(const Map& map)
+{
+    map_ = &map;
+    neighbour_offsets_ = map.neighbour_offsets();
+    stride_ = map.stride();
+    ocean_cells_ = map.ocean_cells();
+    number_of_ocean_cells_ = std::max<int>(map.ocean_cells().count(), 1);
+    number_of_sectors_ = map.dimensions().number_of_sectors();
+    torpedo_range_cells_.assign(map.padded_size(), Bitboard(map.padded_size()));
+    map.ocean_cells().for_each([&](int index)
+    {
+        torpedo_range_cells_[index] = torpedo_origin_cells(map, map.position(index));
+    });
+    opponent_indices_.reserve(map.padded_size());
+    opponent_cumulative_weights_.reserve(map.padded_size());
+}
+
+Turn_vector<Rollout_engine::Action_stats> Rollout_engine::evaluate(const Map& map, const Rollout_state& root, const Opponent& opponent,
+                                                                   const Turn_vector<Rollout_action>& actions, Clock::time_point deadline)
+{
+    Turn_vector<Action_stats> stats(turn_resource());
+    std::size_t number_of_actions = std::min(actions.size(), max_number_of_actions);
+    for (std::size_t i = 0; i < number_of_actions; ++i)
+        stats.push_back(Action_stats{ actions[i], 0., 0 });
+    number_of_playouts_ = 0;
+
+    map_ = &map;
+    actions_ = &actions;
+    opponent_indices_.clear();
+    opponent_cumulative_weights_.clear();
+    uint64_t total_weight = 0;
+    for (int index : opponent.candidate_indices())
+    {
+        total_weight += opponent.weight(index);
+        opponent_indices_.push_back(index);
+        opponent_cumulative_weights_.push_back(total_weight);
+    }
+    if (number_of_actions == 0 || total_weight == 0)
+        return stats;
+
+    std::array<Scores, max_number_of_threads> thread_scores = {};
+    std::array<Counts, max_number_of_threads> thread_counts = {};
+    int number_of_threads = std::min(number_of_threads_, max_number_of_threads);
+    if (number_of_threads == 1)
+        run_(priv::rand_int_engine()(), root, deadline, thread_scores[0], thread_counts[0]);
+    else
+    {
+        std::array<std::thread, max_number_of_threads> threads;
+        for (int i = 0; i < number_of_threads; ++i)
+            threads[i] = std::thread(&Rollout_engine::run_, this, priv::rand_int_engine()(), std::cref(root), deadline,
+                                     std::ref(thread_scores[i]), std::ref(thread_counts[i]));
+        for (int i = 0; i < number_of_threads; ++i)
+            threads[i].join();
+    }
+
+    for (int t = 0; t < number_of_threads; ++t)
+    {
+        for (std::size_t i = 0; i < number_of_actions; ++i)
+        {
+            stats[i].score_sum += thread_scores[t][i];
+            stats[i].number_of_playouts += thread_counts[t][i];
+            number_of_playouts_ += thread_counts[t][i];
+        }
+    }
+    return stats;
+}
+
+void Rollout_engine::run_(uint64_t seed, const Rollout_state& root, Clock::time_point deadline, Scores& scores, Counts& counts) const
+{
+    Fast_rng rng(seed);
+    std::size_t number_of_actions = std::min(actions_->size(), max_number_of_actions);
+    do
+    {
+        for (int i = 0; i < playout_batch_size; ++i)
+        {
+            // The same opponent position for every action: their scores differ by the action only.
+            int opponent_index = sample_opponent_index_(rng);
+            for (std::size_t a = 0; a < number_of_actions; ++a)
+            {
+                Rollout_state state = root;
+                state.them.index = opponent_index;
+                state.them.visited.set(opponent_index);
+                scores[a] += play_(state, (*actions_)[a], rng);
+                ++counts[a];
+            }
+        }
+    }
+    while (Clock::now() < deadline);
+}
+
+int Rollout_engine::sample_opponent_index_(Fast_rng& rng) const
+{
+    uint64_t value = rng() % opponent_cumulative_weights_.back();
+    auto iter = std::upper_bound(opponent_cumulative_weights_.begin(), opponent_cumulative_weights_.end(), value);
+    return opponent_indices_[iter - opponent_cumulative_weights_.begin()];
+}
+
+double Rollout_engine::play_(Rollout_state& state, const Rollout_action& action, Fast_rng& rng) const
+{
+    Rollout_state::Submarine& us = state.us;
+    Rollout_state::Submarine& them = state.them;
+    auto is_over = [&]() { return us.hp <= 0 || them.hp <= 0; };
+
+    // Our action.
+    if (action.fires_torpedo())
+    {
+        int target_index = map_->index(action.torpedo_target);
+        us.hp -= blast_damage_(target_index, us.index);
+        them.hp -= blast_damage_(target_index, them.index);
+        us.torpedo_cooldown = Torpedo::total_cooldown();
+        us.exposure = std::min<int>(us.exposure, torpedo_range_cells_[target_index].count());
+    }
+    if (action.surface)
+    {
+        --us.hp;
+        us.visited.clear();
+        us.visited.set(us.index);
+        us.exposure = std::min(us.exposure, number_of_ocean_cells_ / number_of_sectors_ + 1);
+    }
+    else if (dir_is_valid(action.dir))
+    {
+        int offset = neighbour_offsets_[action.dir];
+        int distance = action.is_silence() ? action.silence_distance : 1;
+        for (int i = 0; i < distance; ++i)
+        {
+            us.index += offset;
+            us.visited.set(us.index);
+        }
+        if (action.is_silence())
+        {
+            us.silence_cooldown = Silence::total_cooldown();
+            us.exposure = std::min(us.exposure * (2 * Silence::max_distance() + 1), number_of_ocean_cells_);
+        }
+        else
+            charge_(us, action.charge);
+    }
+
+    // Then the default policies, the opponent first.
+    for (int turn = 0; turn < horizon_ && !is_over(); ++turn)
+    {
+        fire_(them, us, rng);
+        if (is_over())
+            break;
+        move_randomly_(them, rng);
+        if (turn + 1 == horizon_ || is_over())
+            break;
+        fire_(us, them, rng);
+        if (is_over())
+            break;
+        move_randomly_(us, rng);
+    }
+
+    double score = std::max(us.hp, 0) - std::max(them.hp, 0);
+    if (them.hp <= 0)
+        score += sunk_bonus;
+    if (us.hp <= 0)
+        score -= sunk_bonus;
+    return score;
+}
+
+void Rollout_engine::move_randomly_(Rollout_state::Submarine& submarine, Fast_rng& rng) const
+{
+    std::array<int, 4> free_indices;
+    int number_of_free_indices = 0;
+    for (int offset : neighbour_offsets_)
+    {
+        int nindex = submarine.index + offset;
+        if (ocean_cells_.test(nindex) && !submarine.visited.test(nindex))
+            free_indices[number_of_free_indices++] = nindex;
+    }
+    if (number_of_free_indices == 0)
+    {
+        --submarine.hp;
+        submarine.visited.clear();
+        submarine.visited.set(submarine.index);
+        submarine.exposure = std::min(submarine.exposure, number_of_ocean_cells_ / number_of_sectors_ + 1);
+        return;
+    }
+    submarine.index = free_indices[rng.below(number_of_free_indices)];
+    submarine.visited.set(submarine.index);
+    charge_(submarine);
+}
+
+void Rollout_engine::charge_(Rollout_state::Submarine& submarine, std::string_view charge) const
+{
+    if (charge == "SILENCE" && submarine.silence_cooldown > 0)
+        --submarine.silence_cooldown;
+    else if (submarine.torpedo_cooldown > 0)
+        --submarine.torpedo_cooldown;
+    else if (submarine.silence_cooldown > 0)
+        --submarine.silence_cooldown;
+}
+
+bool Rollout_engine::fire_(Rollout_state::Submarine& shooter, Rollout_state::Submarine& target, Fast_rng& rng) const
+{
+    if (shooter.torpedo_cooldown > 0 || !torpedo_range_cells_[shooter.index].test(target.index))
+        return false;
+    // The shooter picks one of the exposure positions it considers possible, and only fires
+    // when it is close enough to be worth it: here, when it lands in the 3x3 square of the target.
+    uint32_t pick = rng.below(static_cast<uint32_t>(std::max(target.exposure, 1)));
+    if (pick >= 9)
+        return false;
+    int aim_index = target.index;
+    if (pick > 0)
+    {
+        static constexpr std::array<std::array<int, 2>, 8> around = {{ {-1,-1}, {0,-1}, {1,-1}, {-1,0}, {1,0}, {-1,1}, {0,1}, {1,1} }};
+        aim_index += around[pick - 1][0] + around[pick - 1][1] * stride_;
+        if (!ocean_cells_.test(aim_index))
+            return false;
+    }
+    // Never in its own blast.
+    if (blast_damage_(aim_index, shooter.index) > 0)
+        return false;
+
+    target.hp -= blast_damage_(aim_index, target.index);
+    shooter.torpedo_cooldown = Torpedo::total_cooldown();
+    shooter.exposure = std::min<int>(shooter.exposure, torpedo_range_cells_[aim_index].count());
+    return true;
+}
+
+int Rollout_engine::blast_damage_(int target_index, int index) const
+{
+    int dx = std::abs(target_index % stride_ - index % stride_);
+    int dy = std::abs(target_index / stride_ - index / stride_);
+    int distance = std::max(dx, dy);
+    return distance == 0 ? 2 : distance == 1 ? 1 : 0;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "bitboard.hpp"
+#include "direction.hpp"
+#include "memory.hpp"
+#include "grid.hpp"
+#include "random.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+class Map;
+class Opponent;
+
+// Compact state of the two submarines for the playouts: trivially copyable, so that a playout
+// starts with a plain copy of the root state.
+struct Rollout_state
+{
+    struct Submarine
+    {
+        Bitboard visited;
+        uint64_t visited_key = 0; // Map::visit_key() of visited, in the state of the turn only
+        int index = 0;
+        int hp = 0;
+        int torpedo_cooldown = 0;
+        int silence_cooldown = 0;
+        // Number of positions the other one considers possible for this submarine.
+        int exposure = 1;
+    };
+
+    Submarine us;
+    Submarine them; // index is sampled for each playout
+};
+
+// One of our candidate orders for this turn.
+struct Rollout_action
+{
+    Position torpedo_target = Position(-1,-1); // none if negative
+    Direction dir = Undefined;
+    int silence_distance = -1; // MOVE if negative
+    bool surface = false;
+    std::string_view charge; // tool charged by a MOVE, the default choice if empty
+    bool fires_after_move = false; // the torpedo is fired from the square reached
+
+    bool fires_torpedo() const { return torpedo_target.x >= 0; }
+    bool is_silence() const { return silence_distance >= 0; }
+};
+
+// Scores candidate actions by Monte Carlo playouts: the position of the opponent is sampled from
+// the weights of the tracker, our action is played, then both submarines follow a cheap default
+// policy for a few turns (random moves, torpedoes when charged and in range). The score of a
+// playout is the difference of hit points at its end, a sunk submarine counting for more.
+//
+// Torpedoes in the playouts are aimed at the true position with a probability given by the
+// exposure of the target: one of exposure positions is picked, a direct hit being 1 chance in
+// exposure and a blast 8 more.
+class Rollout_engine
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    inline static constexpr std::size_t max_number_of_actions = 16;
+    // A sunk submarine counts for this many hit points more.
+    inline static constexpr double sunk_bonus = 10.;
+
+    struct Action_stats
+    {
+        Rollout_action action;
+        double score_sum = 0;
+        std::size_t number_of_playouts = 0;
+
+        double mean_score() const { return number_of_playouts > 0 ? score_sum / number_of_playouts : 0.; }
+    };
+
+    void init(const Map& map);
+
+    // Playouts are spread on this number of threads (1: the calling thread only).
+    void set_number_of_threads(int number_of_threads) { number_of_threads_ = std::max(number_of_threads, 1); }
+    // Number of turns of each submarine played after our action.
+    void set_horizon(int horizon) { horizon_ = horizon; }
+
+    // Runs playouts of each action (at most max_number_of_actions), round robin, until deadline.
+    Turn_vector<Action_stats> evaluate(const Map& map, const Rollout_state& root, const Opponent& opponent,
+                                       const Turn_vector<Rollout_action>& actions, Clock::time_point deadline);
+    std::size_t number_of_playouts() const { return number_of_playouts_; }
+
+private:
+    using Scores = std::array<double, max_number_of_actions>;
+    using Counts = std::array<std::size_t, max_number_of_actions>;
+
+    void run_(uint64_t seed, const Rollout_state& root, Clock::time_point deadline, Scores& scores, Counts& counts) const;
+    double play_(Rollout_state& state, const Rollout_action& action, Fast_rng& rng) const;
+    // Plays a MOVE (or SURFACE when stuck) in a random direction.
+    void move_randomly_(Rollout_state::Submarine& submarine, Fast_rng& rng) const;
+    // Charges the tool named charge if it is not ready yet, the torpedo first otherwise.
+    void charge_(Rollout_state::Submarine& submarine, std::string_view charge = {}) const;
+    // Fires at target if charged and in range; returns false otherwise.
+    bool fire_(Rollout_state::Submarine& shooter, Rollout_state::Submarine& target, Fast_rng& rng) const;
+    int blast_damage_(int target_index, int index) const;
+    int sample_opponent_index_(Fast_rng& rng) const;
+
+    const Map* map_ = nullptr;
+    std::array<int, 4> neighbour_offsets_ = {};
+    int stride_ = 0;
+    Bitboard ocean_cells_;
+    int number_of_ocean_cells_ = 1;
+    int number_of_sectors_ = 1;
+    std::vector<Bitboard> torpedo_range_cells_; // [index]: squares a torpedo fired from index can reach
+    int number_of_threads_ = 1;
+    int horizon_ = 3;
+
+    // Per evaluation. The threads only read them.
+    const Turn_vector<Rollout_action>* actions_ = nullptr;
+    std::vector<int> opponent_indices_;
+    std::vector<uint64_t> opponent_cumulative_weights_;
+    std::size_t number_of_playouts_ = 0;
+};
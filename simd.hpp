@@ -0,0 +1,194 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Compare/blend kernels over contiguous runs of int16_t cells (mark map rows), and shift
+// kernels over uint32_t cells (weight maps).
+// The instruction set is chosen at build time: AVX2 (16 cells per instruction) when compiled
+// with -mavx2, SSE2 (8 cells) on any x86-64 target, plain loops otherwise.
+//
+// The last, partial vector of a run is processed with a lane mask: it may read and rewrite
+// (unchanged) up to int16_lanes - 1 cells past the end of the run, so the buffer must extend
+// that far. Padded_grid reserves these cells after its border.
+namespace simd
+{
+#if defined(__AVX2__)
+inline constexpr int int16_lanes = 16;
+#elif defined(__SSE2__)
+inline constexpr int int16_lanes = 8;
+#else
+inline constexpr int int16_lanes = 1;
+#endif
+
+namespace priv
+{
+#if defined(__AVX2__)
+using Vector = __m256i;
+inline Vector load(const int16_t* data) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data)); }
+inline void store(int16_t* data, Vector vector) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(data), vector); }
+inline Vector broadcast(int16_t value) { return _mm256_set1_epi16(value); }
+inline Vector equal(Vector lhs, Vector rhs) { return _mm256_cmpeq_epi16(lhs, rhs); }
+inline Vector both(Vector lhs, Vector rhs) { return _mm256_and_si256(lhs, rhs); }
+inline Vector but_not(Vector lhs, Vector rhs) { return _mm256_andnot_si256(rhs, lhs); }
+// mask ? if_true : if_false, lane by lane.
+inline Vector select(Vector mask, Vector if_true, Vector if_false) { return _mm256_blendv_epi8(if_false, if_true, mask); }
+inline Vector first_lanes(int count)
+{
+    const Vector lane_indices = _mm256_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    return _mm256_cmpgt_epi16(_mm256_set1_epi16(static_cast<int16_t>(count)), lane_indices);
+}
+// Two bits per lane.
+inline uint32_t lane_bits(Vector mask) { return static_cast<uint32_t>(_mm256_movemask_epi8(mask)); }
+#elif defined(__SSE2__)
+using Vector = __m128i;
+inline Vector load(const int16_t* data) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)); }
+inline void store(int16_t* data, Vector vector) { _mm_storeu_si128(reinterpret_cast<__m128i*>(data), vector); }
+inline Vector broadcast(int16_t value) { return _mm_set1_epi16(value); }
+inline Vector equal(Vector lhs, Vector rhs) { return _mm_cmpeq_epi16(lhs, rhs); }
+inline Vector both(Vector lhs, Vector rhs) { return _mm_and_si128(lhs, rhs); }
+inline Vector but_not(Vector lhs, Vector rhs) { return _mm_andnot_si128(rhs, lhs); }
+inline Vector select(Vector mask, Vector if_true, Vector if_false)
+{
+    return _mm_or_si128(_mm_and_si128(mask, if_true), _mm_andnot_si128(mask, if_false));
+}
+inline Vector first_lanes(int count)
+{
+    const Vector lane_indices = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7);
+    return _mm_cmpgt_epi16(_mm_set1_epi16(static_cast<int16_t>(count)), lane_indices);
+}
+inline uint32_t lane_bits(Vector mask) { return static_cast<uint32_t>(_mm_movemask_epi8(mask)); }
+#endif
+
+// Calls function(offset, mask) for each vector of [0,size[, mask selecting the lanes inside the run.
+template <class Function>
+inline void for_each_vector(int size, Function&& function)
+{
+#if defined(__AVX2__) || defined(__SSE2__)
+    const Vector all_lanes = first_lanes(int16_lanes);
+    int offset = 0;
+    for (; offset + int16_lanes <= size; offset += int16_lanes)
+        function(offset, all_lanes);
+    if (offset < size)
+        function(offset, first_lanes(size - offset));
+#else
+    (void)size;
+    (void)function;
+#endif
+}
+}
+
+// Replaces every cell different from value_to_keep by value.
+inline void replace_not_equal(int16_t* data, int size, int16_t value_to_keep, int16_t value)
+{
+#if defined(__AVX2__) || defined(__SSE2__)
+    using namespace priv;
+    const Vector values_to_keep = broadcast(value_to_keep);
+    const Vector values = broadcast(value);
+    for_each_vector(size, [&](int offset, Vector lanes)
+    {
+        Vector cells = load(data + offset);
+        store(data + offset, select(but_not(lanes, equal(cells, values_to_keep)), values, cells));
+    });
+#else
+    for (int i = 0; i < size; ++i)
+        if (data[i] != value_to_keep)
+            data[i] = value;
+#endif
+}
+
+// Calls function(i) for each cell data[i] equal to value, in increasing order of i.
+template <class Function>
+inline void for_each_equal(const int16_t* data, int size, int16_t value, Function&& function)
+{
+#if defined(__AVX2__) || defined(__SSE2__)
+    using namespace priv;
+    const Vector values = broadcast(value);
+    for_each_vector(size, [&](int offset, Vector lanes)
+    {
+        for (uint32_t bits = lane_bits(both(equal(load(data + offset), values), lanes)); bits != 0; bits &= bits - 1)
+        {
+            function(offset + __builtin_ctz(bits) / 2);
+            bits &= bits - 1;
+        }
+    });
+#else
+    for (int i = 0; i < size; ++i)
+        if (data[i] == value)
+            function(i);
+#endif
+}
+
+// Fixed-point weight kernels over uint32_t cells. Whole vectors go through the vector unit and
+// the remaining cells through a plain loop, so they need no padding.
+namespace priv
+{
+template <class Vector_function, class Cell_function>
+inline void for_each_uint32_vector(uint32_t* data, int size, Vector_function&& vector_function, Cell_function&& cell_function)
+{
+    int offset = 0;
+#if defined(__AVX2__)
+    for (; offset + 8 <= size; offset += 8)
+    {
+        __m256i* cells = reinterpret_cast<__m256i*>(data + offset);
+        _mm256_storeu_si256(cells, vector_function(_mm256_loadu_si256(cells)));
+    }
+#elif defined(__SSE2__)
+    for (; offset + 4 <= size; offset += 4)
+    {
+        __m128i* cells = reinterpret_cast<__m128i*>(data + offset);
+        _mm_storeu_si128(cells, vector_function(_mm_loadu_si128(cells)));
+    }
+#else
+    (void)vector_function;
+#endif
+    for (; offset < size; ++offset)
+        data[offset] = cell_function(data[offset]);
+}
+}
+
+// Multiplies every cell by 2^shift.
+inline void shift_left(uint32_t* data, int size, int shift)
+{
+#if defined(__AVX2__) || defined(__SSE2__)
+    const __m128i count = _mm_cvtsi32_si128(shift);
+#endif
+    priv::for_each_uint32_vector(data, size,
+        [&](auto cells)
+        {
+#if defined(__AVX2__)
+            return _mm256_sll_epi32(cells, count);
+#elif defined(__SSE2__)
+            return _mm_sll_epi32(cells, count);
+#else
+            return cells;
+#endif
+        },
+        [&](uint32_t cell) { return cell << shift; });
+}
+
+// Divides every cell by 2^shift, rounding up: non-zero cells stay non-zero.
+inline void shift_right_rounding_up(uint32_t* data, int size, int shift)
+{
+    const uint32_t rounding = (1u << shift) - 1;
+#if defined(__AVX2__) || defined(__SSE2__)
+    const __m128i count = _mm_cvtsi32_si128(shift);
+#endif
+    priv::for_each_uint32_vector(data, size,
+        [&](auto cells)
+        {
+#if defined(__AVX2__)
+            return _mm256_srl_epi32(_mm256_add_epi32(cells, _mm256_set1_epi32(rounding)), count);
+#elif defined(__SSE2__)
+            return _mm_srl_epi32(_mm_add_epi32(cells, _mm_set1_epi32(rounding)), count);
+#else
+            return cells;
+#endif
+        },
+        [&](uint32_t cell) { return (cell + rounding) >> shift; });
+}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "grid.hpp"
+#include <array>
+#include <cstddef>
+
+template <std::size_t Size>
+struct Stencil
+{
+    std::array<Offset, Size> offsets;
+
+    constexpr const Offset* begin() const { return offsets.data(); }
+    constexpr const Offset* end() const { return offsets.data() + Size; }
+    static constexpr std::size_t size() { return Size; }
+};
+
+constexpr std::size_t square_stencil_size(int radius) { return (2 * radius + 1) * (2 * radius + 1); }
+
+// Offsets at Chebyshev distance <= Radius, in row-major order.
+template <int Radius>
+constexpr Stencil<square_stencil_size(Radius)> make_square_stencil()
+{
+    Stencil<square_stencil_size(Radius)> stencil{};
+    std::size_t index = 0;
+    for (int j = -Radius; j <= Radius; ++j)
+        for (int i = -Radius; i <= Radius; ++i)
+            stencil.offsets[index++] = Offset(i,j);
+    return stencil;
+}
+
+inline constexpr auto blast_stencil = make_square_stencil<1>();
+
+static_assert(blast_stencil.size() == 9);
+
+// Calls function(pos) for each position of the stencil centered on center which lies in [0,width[ x [0,height[.
+template <class Stencil_type, class Function>
+constexpr void for_each_clipped(const Stencil_type& stencil, const Position& center, int width, int height, Function&& function)
+{
+    for (const Offset& offset : stencil)
+    {
+        Position pos = center + offset;
+        if (pos.x >= 0 && pos.x < width && pos.y >= 0 && pos.y < height)
+            function(pos);
+    }
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "grid.hpp"
+#include "bitboard.hpp"
 #include <string_view>
 #include <cstdint>
 #include <cassert>
@@ -37,16 +38,13 @@ struct Sonar : public Tool
     explicit Sonar(Player& player) : Tool(player, total_cooldown()) {}
 
     int requested_sector() const { return requested_sector_; }
-    void set_request(int sector)
-    {
-        requested_sector_ = sector;
-//        request_answer_ = false;
-    }
-    void reset_request() { set_request(-1); }
+    void set_request(int sector);
+    void reset_request() { requested_sector_ = -1; }
     void update_info(const std::string& sonar_result);
 
 private:
     int requested_sector_ = -1;
+    int opponent_path_index_ = -1;
 //    bool request_answer_ = false;
 };
 
@@ -57,12 +55,10 @@ public:
     inline static constexpr int max_radius() { return 4; }
 
     explicit Torpedo(Player& player) : Tool(player, total_cooldown()) {}
-    void fire_to(Position targeted_position)
-    {
-        targeted_position_ = targeted_position;
-    }
+    void fire_to(Position targeted_position) { targeted_position_ = targeted_position; }
+    // Target of the torpedo fired last turn, (-1,-1) if none.
+    const Position& targeted_position() const { return targeted_position_; }
     void reset_targeted_position() { targeted_position_ = Position(-1,-1); }
-    void update_info();
 
 private:
     Position targeted_position_ = Position(-1,-1);
@@ -72,6 +68,7 @@ struct Silence : public Tool
 {
 public:
     inline static constexpr int total_cooldown() { return 6; }
+    inline static constexpr int max_distance() { return 4; }
 
     explicit Silence(Player& player) : Tool(player, total_cooldown()) {}
 
@@ -86,6 +83,15 @@ public:
 
     explicit Mine(Player& player) : Tool(player, total_cooldown()) {}
 
+    // Squares of our mines still in place, by cell index (empty before the first drop).
+    const Bitboard& cells() const { return cells_; }
+    void drop(int index);
+    void trigger(Position triggered_position);
+    // Square of the mine triggered last turn, (-1,-1) if none.
+    const Position& triggered_position() const { return triggered_position_; }
+    void reset_triggered_position() { triggered_position_ = Position(-1,-1); }
+
 private:
-    //TODO
+    Bitboard cells_;
+    Position triggered_position_ = Position(-1,-1);
 };
@@ -0,0 +1,51 @@
+#include "torpedo_targeting.hpp"
+#include "tracking.hpp"
+#include "map.hpp"
+#include "opponent.hpp"
+#include <algorithm>
+#include <cstdlib>
+
+void Torpedo_targeting::init(const Map& map)
+{
+    blast_cells_.assign(map.padded_size(), Bitboard(map.padded_size()));
+    map.ocean_cells().for_each([&](int index)
+    {
+        Bitboard& cells = blast_cells_[index];
+        cells.set(index);
+        spread_blast(map, cells);
+    });
+}
+
+Torpedo_target Torpedo_targeting::evaluate(const Map& map, const Position& target, const Opponent& opponent, const Bitboard& opponent_positions,
+                                           const Position& own_position) const
+{
+    int index = map.index(target);
+    Torpedo_target res;
+    res.position = target;
+    res.total_weight = opponent.total_weight();
+    // The target itself is in its blast: 1 + 1 for a direct hit.
+    res.opponent_damage = opponent.weight(index);
+    (blast_cells_[index] & opponent_positions).for_each([&](int blasted_index)
+    {
+        res.opponent_damage += opponent.weight(blasted_index);
+    });
+    int own_distance = std::max(std::abs(own_position.x - target.x), std::abs(own_position.y - target.y));
+    res.self_damage = own_distance == 0 ? 2 : own_distance == 1 ? 1 : 0;
+    return res;
+}
+
+Torpedo_target Torpedo_targeting::best_target(const Map& map, const Turn_vector<Position>& targets, const Opponent& opponent,
+                                              const Position& own_position, int own_hp) const
+{
+    Bitboard opponent_positions = opponent.possible_positions();
+    Torpedo_target best;
+    for (const Position& target : targets)
+    {
+        Torpedo_target candidate = evaluate(map, target, opponent, opponent_positions, own_position);
+        if (candidate.self_damage >= own_hp)
+            continue;
+        if (best.total_weight == 0 || candidate.score() > best.score())
+            best = candidate;
+    }
+    return best;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "bitboard.hpp"
+#include "memory.hpp"
+#include "grid.hpp"
+#include <cstdint>
+#include <vector>
+
+class Map;
+class Opponent;
+
+// Outcome of a torpedo fired at position, averaged over the possible positions of the opponent
+// (see Opponent::weight).
+struct Torpedo_target
+{
+    Position position = Position(-1,-1);
+    int64_t opponent_damage = 0; // summed over the possible positions, times their weights
+    int64_t total_weight = 0;
+    int self_damage = 0;
+
+    // Expected damage dealt minus damage taken, times total_weight.
+    int64_t score() const { return opponent_damage - self_damage * total_weight; }
+    double expected_damage() const { return total_weight > 0 ? double(opponent_damage) / total_weight : 0.; }
+    // On average at least half a hit point more for the opponent than for us.
+    bool is_worth_firing() const { return total_weight > 0 && 2 * score() >= total_weight; }
+};
+
+// Scores torpedo targets by expected damage: 2 for a direct hit, 1 for the rest of the 3x3 blast.
+class Torpedo_targeting
+{
+public:
+    // Precomputes the blast of each square.
+    void init(const Map& map);
+
+    // opponent_positions: opponent.possible_positions().
+    Torpedo_target evaluate(const Map& map, const Position& target, const Opponent& opponent, const Bitboard& opponent_positions,
+                            const Position& own_position) const;
+
+    // Best of targets, ignoring the ones whose blast would sink us (own_hp or more damage).
+    Torpedo_target best_target(const Map& map, const Turn_vector<Position>& targets, const Opponent& opponent,
+                               const Position& own_position, int own_hp) const;
+
+private:
+    std::vector<Bitboard> blast_cells_; // blast_cells_[index]: the 3x3 square centered on index
+};
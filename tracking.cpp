@@ -0,0 +1,89 @@
+#include "tracking.hpp"
+#include "map.hpp"
+#include "tool.hpp"
+#include "stencil.hpp"
+#include <algorithm>
+#include <cstdlib>
+
+void propagate_move(const Map& map, Bitboard& positions, Direction dir)
+{
+    // Land borders the map, so a shifted position never wraps to another row.
+    positions.shift(map.neighbour_offset(dir)) &= map.ocean_cells();
+}
+
+void spread(const Map& map, Bitboard& cells)
+{
+    Bitboard spread_cells = cells;
+    for (unsigned i = 0; i < number_of_directions(); ++i)
+    {
+        Bitboard moved_cells = cells;
+        propagate_move(map, moved_cells, Direction(i));
+        spread_cells |= moved_cells;
+    }
+    cells = spread_cells;
+}
+
+void spread_blast(const Map& map, Bitboard& cells)
+{
+    // Rows first, then columns: the border keeps a blast from wrapping around a row.
+    Bitboard row_cells = cells;
+    row_cells |= Bitboard(cells).shift(1);
+    row_cells |= Bitboard(cells).shift(-1);
+    cells = row_cells;
+    cells |= Bitboard(row_cells).shift(map.stride());
+    cells |= Bitboard(row_cells).shift(-map.stride());
+}
+
+Bitboard mine_drop_cells(const Map& map, const Bitboard& positions)
+{
+    Bitboard cells(map.padded_size());
+    for (unsigned i = 0; i < number_of_directions(); ++i)
+    {
+        Bitboard moved_cells = positions;
+        propagate_move(map, moved_cells, Direction(i));
+        cells |= moved_cells;
+    }
+    return cells;
+}
+
+void propagate_silence(const Map& map, Bitboard& positions, Silence_rays trail_rays)
+{
+    Bitboard destinations = positions;
+    for (unsigned i = 0; i < number_of_directions(); ++i)
+    {
+        Direction dir = Direction(i);
+        Bitboard ray = positions;
+        for (int length = silence_ray_length(trail_rays, dir); length > 0 && ray.any(); --length)
+        {
+            propagate_move(map, ray, dir);
+            destinations |= ray;
+        }
+    }
+    positions = destinations;
+}
+
+Bitboard torpedo_origin_cells(const Map& map, const Position& target)
+{
+    Bitboard cells(map.padded_size());
+    for (const Position& pos : map.reachable_squares(target, Torpedo::max_radius()))
+        cells.set(map.index(pos));
+    return cells;
+}
+
+Bitboard blast_damage_cells(const Map& map, const Position& target, int damage)
+{
+    if (damage < 0 || damage > 2)
+        return map.ocean_cells();
+    Bitboard cells(map.padded_size());
+    if (damage == 0)
+        cells = map.ocean_cells();
+    for_each_clipped(blast_stencil, target, map.width(), map.height(), [&](const Position& pos)
+    {
+        int distance = std::max(std::abs(pos.x - target.x), std::abs(pos.y - target.y));
+        if (damage == 0)
+            cells.reset(map.index(pos));
+        else if (distance == 2 - damage)
+            cells.set(map.index(pos));
+    });
+    return cells & map.ocean_cells();
+}
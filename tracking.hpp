@@ -0,0 +1,70 @@
+#pragma once
+
+#include "bitboard.hpp"
+#include "direction.hpp"
+#include "grid.hpp"
+#include "tool.hpp"
+#include <cstdint>
+#include <cstdlib>
+
+class Map;
+
+// Bitboard versions of the submarine tracking rules: each function turns the set of the possible
+// positions of a submarine before an order into the set after it, with a few word operations.
+
+// Trail of the path since the last SURFACE on the rays of a SILENCE from the current position, as
+// a bitboard of Silence::max_distance() bits per direction: bit max_distance * dir + k - 1 is set
+// when the square k steps away in dir was visited. path holds the directions of the MOVE orders,
+// Undefined for a SILENCE; the walk back stops at the first SILENCE, whose vector is unknown. The
+// last direction of path is the order being treated and is skipped.
+using Silence_rays = uint16_t;
+static_assert(4 * Silence::max_distance() <= 16);
+
+template <class Path>
+Silence_rays relative_trail_rays(const Path& path)
+{
+    Silence_rays rays = 0;
+    Position pos(0,0);
+    for (auto iter = path.rbegin() + (path.empty() ? 0 : 1), end_iter = path.rend(); iter != end_iter; ++iter)
+    {
+        Direction dir = *iter;
+        if (!dir_is_valid(dir))
+            break;
+        pos.move(opposed_direction(dir));
+        int distance = std::abs(pos.x) + std::abs(pos.y);
+        if ((pos.x == 0 || pos.y == 0) && distance > 0 && distance <= Silence::max_distance())
+        {
+            Direction ray_dir = pos.x > 0 ? East : pos.x < 0 ? West : pos.y > 0 ? South : North;
+            rays |= Silence_rays(1) << (Silence::max_distance() * ray_dir + distance - 1);
+        }
+    }
+    return rays;
+}
+
+// Number of squares a SILENCE can cross in dir before the first square of the trail: one mask test.
+inline int silence_ray_length(Silence_rays rays, Direction dir)
+{
+    constexpr unsigned ray_mask = (1u << Silence::max_distance()) - 1;
+    return __builtin_ctz(((rays >> (Silence::max_distance() * dir)) & ray_mask) | (ray_mask + 1));
+}
+
+void propagate_move(const Map& map, Bitboard& positions, Direction dir);
+
+// Adds the ocean squares next to cells (one step of a breadth-first search on the ocean).
+void spread(const Map& map, Bitboard& cells);
+
+// Adds the squares of the 3x3 blasts centered on cells.
+void spread_blast(const Map& map, Bitboard& cells);
+
+// Ocean squares next to positions: where a MINE order made from one of them drops its mine.
+Bitboard mine_drop_cells(const Map& map, const Bitboard& positions);
+
+// A silence ray stops before a square of the trail (see relative_trail_rays) or a land square.
+void propagate_silence(const Map& map, Bitboard& positions, Silence_rays trail_rays);
+
+// Squares from which a torpedo can reach target.
+Bitboard torpedo_origin_cells(const Map& map, const Position& target);
+
+// Squares where a submarine takes damage from a blast at target (2 at target, 1 around it,
+// 0 elsewhere). Returns every ocean square for any other damage.
+Bitboard blast_damage_cells(const Map& map, const Position& target, int damage);
@@ -1,11 +1,17 @@
 #pragma once
 
+#include <cstddef>
 #include <string>
 #include <istream>
 #include <ostream>
 
 struct Turn_info
 {
+    // Longer than any line of orders, so that reading them never allocates.
+    inline static constexpr std::size_t orders_capacity = 256;
+
+    Turn_info() { opponentOrders.reserve(orders_capacity); }
+
     // Self info
     int x = -1;
     int y = -1;
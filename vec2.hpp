@@ -1,7 +1,7 @@
 #pragma once
 
 #include "direction.hpp"
-#include <vector>
+#include <string>
 
 class Vec2
 {
@@ -9,32 +9,40 @@ public:
     int x = 0;
     int y = 0;
 
-    Vec2() = default;
-    Vec2(int x, int y);
+    constexpr Vec2() = default;
+    constexpr Vec2(int x, int y) : x(x), y(y) {}
 
-    Vec2& operator+=(const Vec2& rhs);
+    constexpr Vec2& operator+=(const Vec2& rhs) { x += rhs.x; y += rhs.y; return *this; }
 
-    friend Vec2 operator+(const Vec2& lfs, const Vec2& rhs);
+    friend constexpr Vec2 operator+(const Vec2& lfs, const Vec2& rhs) { Vec2 res = lfs; res += rhs; return res; }
 
-    Vec2& operator-=(const Vec2& rhs);
+    constexpr Vec2& operator-=(const Vec2& rhs) { x -= rhs.x; y -= rhs.y; return *this; }
 
-    friend Vec2 operator-(const Vec2& lfs, const Vec2& rhs);
+    friend constexpr Vec2 operator-(const Vec2& lfs, const Vec2& rhs) { Vec2 res = lfs; res -= rhs; return res; }
 
-    bool operator==(const Vec2& rfs) const;
+    constexpr bool operator==(const Vec2& rfs) const { return x == rfs.x && y == rfs.y; }
 
-    bool operator!=(const Vec2& rfs) const;
+    constexpr bool operator!=(const Vec2& rfs) const { return x != rfs.x || y != rfs.y; }
 
-    bool operator<(const Vec2& rfs) const;
+    constexpr bool operator<(const Vec2& rfs) const { return x < rfs.x || (x == rfs.x && y < rfs.y); }
 
     Vec2& move(Direction dir);
 
     Vec2 neighbour(Direction dir) const;
 
-    std::vector<Vec2> circle_area(unsigned radius) const;
-
-    std::vector<Vec2> square_area(unsigned radius) const;
-
     friend std::ostream& operator<<(std::ostream& stream, const Vec2& vec);
 
     std::string to_string() const;
 };
+
+inline constexpr Vec2 dir_to_vec(Direction dir)
+{
+    switch (dir)
+    {
+    case North: return Vec2(0,-1);
+    case East: return Vec2(1,0);
+    case South: return Vec2(0,1);
+    case West: return Vec2(-1,0);
+    default: return Vec2(0,0);
+    }
+}
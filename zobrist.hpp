@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+// Zobrist hashing: the key of a state is the XOR of the keys of its features (a visited square, a
+// possible position, a value of the hit points...), so that adding or removing a feature costs one
+// XOR. Keys are derived from the number of the feature, the same in every run; hot ones are kept
+// in tables.
+namespace zobrist
+{
+enum Feature_kind : uint64_t
+{
+    Cell = 1,
+    Position,
+    Hp,
+    Cooldown,
+    Exposure,
+    Search_depth
+};
+
+// SplitMix64 finalizer of the feature number.
+inline constexpr uint64_t key(Feature_kind kind, uint64_t value)
+{
+    uint64_t z = (static_cast<uint64_t>(kind) << 48 | value) + 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+}